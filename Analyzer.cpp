@@ -0,0 +1,528 @@
+#include "Analyzer.hpp"
+#include "Disassembler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+    // Addresses I can hold, [first, last]. I is 16 bits wide, so [0, 0xFFFF] is anything.
+    struct IndexRange
+    {
+        unsigned int first;
+        unsigned int last;
+    };
+
+    IndexRange const ANY_INDEX{0, 0xFFFFu};
+
+    // Times the range at an address may grow before it is widened to ANY_INDEX, so loops
+    // that keep adding to I (Fx1E) settle quickly
+    const unsigned int WIDEN_AFTER = 16;
+
+    IndexRange Offset(IndexRange range, unsigned int first, unsigned int last)
+    {
+        if (range.last + last > 0xFFFFu)
+            return ANY_INDEX;
+
+        return IndexRange{range.first + first, range.last + last};
+    }
+
+    IndexRange Join(IndexRange a, IndexRange b)
+    {
+        return IndexRange{std::min(a.first, b.first), std::max(a.last, b.last)};
+    }
+
+    bool operator==(IndexRange a, IndexRange b)
+    {
+        return a.first == b.first && a.last == b.last;
+    }
+
+    IndexQuirk IndexQuirkOf(QuirkProfile quirks)
+    {
+        switch (quirks)
+        {
+            case QuirkProfile::CosmacVip: return CosmacVipQuirks::index;
+            case QuirkProfile::Chip48: return Chip48Quirks::index;
+            case QuirkProfile::SuperChip: return SuperChipQuirks::index;
+            case QuirkProfile::XoChip: return XoChipQuirks::index;
+            default: return DefaultQuirks::index;
+        }
+    }
+
+    // Control flow of an instruction as the profile decodes it (the same decoding as the
+    // function tables, see Disassemble)
+    void Classify(CodeInstruction& instruction, QuirkProfile quirks)
+    {
+        bool extended = quirks == QuirkProfile::SuperChip || quirks == QuirkProfile::XoChip;
+        bool bitPlanes = quirks == QuirkProfile::XoChip;
+
+        uint16_t opcode = instruction.opcode;
+        unsigned int low = opcode & 0x00FFu;
+        unsigned int n = opcode & 0x000Fu;
+        uint16_t next = (instruction.address + 2u) & 0x0FFFu;
+
+        instruction.flow = FlowKind::Next;
+        instruction.target = opcode & 0x0FFFu;
+
+        switch (opcode >> 12u)
+        {
+            case 0x0:
+                if (extended && IsExit(opcode))
+                    instruction.flow = FlowKind::Exit;
+                else if (extended && ((low & 0xF0u) == 0xC0u || low >= 0xFBu))
+                    break;
+                else if (bitPlanes && (low & 0xF0u) == 0xD0u)
+                    break;
+                else if (n == 0xE)
+                    instruction.flow = FlowKind::Return;
+                else if (n != 0x0)
+                    instruction.unknown = true;
+                break;
+
+            case 0x1: instruction.flow = FlowKind::Jump; break;
+            case 0x2: instruction.flow = FlowKind::Call; break;
+            case 0x3: case 0x4: case 0x5: case 0x9: instruction.flow = FlowKind::Skip; break;
+            case 0xB: instruction.flow = FlowKind::IndirectJump; break;
+
+            case 0x8:
+                instruction.unknown = n > 0x7u && n != 0xEu;
+                break;
+
+            case 0xE:
+                if (n == 0xE || n == 0x1)
+                    instruction.flow = FlowKind::Skip;
+                else
+                    instruction.unknown = true;
+                break;
+
+            case 0xF:
+                switch (low)
+                {
+                    case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E: case 0x29:
+                    case 0x33: case 0x55: case 0x65:
+                        break;
+                    case 0x01: case 0x02: case 0x3A: instruction.unknown = !bitPlanes; break;
+                    case 0x30: instruction.unknown = !extended; break;
+                    default: instruction.unknown = true; break;
+                }
+                break;
+        }
+
+        switch (instruction.flow)
+        {
+            case FlowKind::Next:
+                instruction.successors[instruction.successorCount++] = next;
+                break;
+            case FlowKind::Jump:
+                instruction.successors[instruction.successorCount++] = instruction.target;
+                break;
+            case FlowKind::Call:
+                instruction.successors[instruction.successorCount++] = instruction.target;
+                instruction.successors[instruction.successorCount++] = next;
+                break;
+            case FlowKind::Skip:
+                instruction.successors[instruction.successorCount++] = next;
+                instruction.successors[instruction.successorCount++] = (next + 2u) & 0x0FFFu;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Addresses I can hold after the instruction
+    IndexRange Transfer(uint16_t opcode, IndexRange index, IndexQuirk indexQuirk, bool extended)
+    {
+        unsigned int x = (opcode & 0x0F00u) >> 8u;
+
+        switch (opcode >> 12u)
+        {
+            case 0xA:
+                return IndexRange{opcode & 0x0FFFu, opcode & 0x0FFFu};
+
+            case 0xF:
+                switch (opcode & 0x00FFu)
+                {
+                    case 0x1E: return Offset(index, 0, 0xFF);
+                    case 0x29: return IndexRange{FONTSET_START_ADDRESS, FONTSET_START_ADDRESS + 5 * 0xFF};
+                    case 0x30:
+                        if (extended)
+                            return IndexRange{BIG_FONTSET_START_ADDRESS, BIG_FONTSET_START_ADDRESS + 10 * 0xF};
+                        break;
+                    case 0x55: case 0x65:
+                        if (indexQuirk == IndexQuirk::AddX)
+                            return Offset(index, x, x);
+                        if (indexQuirk == IndexQuirk::AddXPlus1)
+                            return Offset(index, x + 1, x + 1);
+                        break;
+                }
+                break;
+        }
+
+        return index;
+    }
+
+    // Bytes written by a store instruction (0 = not a store)
+    unsigned int StoreLength(uint16_t opcode)
+    {
+        if ((opcode & 0xF0FFu) == 0xF033u)
+            return 3;
+        if ((opcode & 0xF0FFu) == 0xF055u)
+            return ((opcode & 0x0F00u) >> 8u) + 1;
+        return 0;
+    }
+
+    // Worklist solver of the I ranges over the control flow graph
+    class IndexSolver
+    {
+    public:
+        IndexSolver(Chip8 const& chip8)
+            : memory(chip8.memory), quirks(chip8.quirks), indexQuirk(IndexQuirkOf(chip8.quirks)),
+              extended(chip8.HasExtendedDisplay())
+        {
+        }
+
+        void Reach(uint16_t address, IndexRange index)
+        {
+            address &= 0x0FFFu;
+
+            if (!reached[address])
+            {
+                reached[address] = true;
+                ranges[address] = index;
+                pending.push_back(address);
+                return;
+            }
+
+            IndexRange joined = Join(ranges[address], index);
+            if (joined == ranges[address])
+                return;
+
+            ranges[address] = ++changes[address] > WIDEN_AFTER ? ANY_INDEX : joined;
+            pending.push_back(address);
+        }
+
+        void Solve()
+        {
+            while (!pending.empty())
+            {
+                uint16_t address = pending.back();
+                pending.pop_back();
+
+                CodeInstruction instruction = Decode(address);
+                IndexRange index = Transfer(instruction.opcode, ranges[address], indexQuirk, extended);
+
+                if (instruction.flow == FlowKind::Return)
+                {
+                    // A return continues after every call, with whatever I any subroutine leaves
+                    IndexRange joined = returns ? Join(returnRange, index) : index;
+                    if (returns && joined == returnRange)
+                        continue;
+
+                    returnRange = joined;
+                    returns = true;
+                    for (uint16_t site : returnSites)
+                        Reach(site, returnRange);
+                    continue;
+                }
+
+                if (instruction.flow == FlowKind::Call)
+                {
+                    // The return site is reached through the subroutine's return
+                    uint16_t site = instruction.successors[1];
+                    if (std::find(returnSites.begin(), returnSites.end(), site) == returnSites.end())
+                    {
+                        returnSites.push_back(site);
+                        if (returns)
+                            Reach(site, returnRange);
+                    }
+
+                    Reach(instruction.target, index);
+                    continue;
+                }
+
+                for (unsigned int i = 0; i < instruction.successorCount; ++i)
+                    Reach(instruction.successors[i], index);
+            }
+        }
+
+        CodeInstruction Decode(uint16_t address) const
+        {
+            CodeInstruction instruction;
+            instruction.address = address;
+            instruction.opcode = (memory[address] << 8u) | memory[(address + 1u) & 0x0FFFu];
+            Classify(instruction, quirks);
+            return instruction;
+        }
+
+        uint8_t const* memory;
+        QuirkProfile quirks;
+        IndexQuirk indexQuirk;
+        bool extended;
+
+        bool reached[MEMORY_SIZE]{};
+        IndexRange ranges[MEMORY_SIZE]{}; // Addresses I can hold before the instruction
+        unsigned int changes[MEMORY_SIZE]{};
+        std::vector<uint16_t> pending;
+
+        std::vector<uint16_t> returnSites; // Instructions after the reachable calls
+        IndexRange returnRange{};          // Addresses I can hold after a return
+        bool returns{};                    // A return is reachable
+    };
+
+    void WriteAddress(std::ostream& out, unsigned int address)
+    {
+        char text[8];
+        std::snprintf(text, sizeof(text), "\"%03X\"", address);
+        out << text;
+    }
+}
+
+RomAnalysis AnalyzeProgram(Chip8 const& chip8, size_t romSize)
+{
+    RomAnalysis analysis;
+    analysis.quirks = chip8.quirks;
+
+    // Machines are too big for comfortable stack use, and so is the solver
+    std::unique_ptr<IndexSolver> solver(new IndexSolver(chip8));
+
+    analysis.entries.push_back(chip8.pc & 0x0FFFu);
+    solver->Reach(chip8.pc, IndexRange{chip8.index, chip8.index});
+
+    // Returns still pending in a restored state continue with any I
+    for (unsigned int i = 0; i < chip8.sp && i < 16; ++i)
+    {
+        analysis.entries.push_back(chip8.stack[i] & 0x0FFFu);
+        solver->Reach(chip8.stack[i], ANY_INDEX);
+    }
+
+    solver->Solve();
+
+    // Instructions and the bytes they are decoded from
+    bool code[MEMORY_SIZE]{};
+    for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (!solver->reached[address])
+            continue;
+
+        CodeInstruction instruction = solver->Decode(static_cast<uint16_t>(address));
+        analysis.instructions.push_back(instruction);
+
+        if (instruction.flow == FlowKind::IndirectJump)
+            analysis.indirectJumps.push_back(instruction.address);
+
+        code[address] = true;
+        code[(address + 1u) & 0x0FFFu] = true;
+    }
+
+    // Stores, with the final ranges of I
+    for (CodeInstruction const& instruction : analysis.instructions)
+    {
+        unsigned int length = StoreLength(instruction.opcode);
+        if (!length)
+            continue;
+
+        IndexRange index = solver->ranges[instruction.address];
+
+        MemoryStore store;
+        store.address = instruction.address;
+        store.anywhere = index.last + length > MEMORY_SIZE;
+        store.first = store.anywhere ? 0 : index.first;
+        store.last = store.anywhere ? MEMORY_SIZE - 1 : index.last + length - 1;
+
+        for (unsigned int address = store.first; address <= store.last && !store.writesCode; ++address)
+            store.writesCode = code[address];
+
+        analysis.writesCode |= store.writesCode;
+        analysis.stores.push_back(store);
+    }
+
+    // Code anywhere, data only inside the ROM
+    unsigned int romEnd = START_ADDRESS + static_cast<unsigned int>(std::min<size_t>(romSize, MAX_ROM_SIZE));
+    for (unsigned int address = 0; address < MEMORY_SIZE; )
+    {
+        bool isCode = code[address];
+        if (!isCode && (address < START_ADDRESS || address >= romEnd))
+        {
+            ++address;
+            continue;
+        }
+
+        MemoryRegion region;
+        region.first = static_cast<uint16_t>(address);
+        region.code = isCode;
+
+        while (address < MEMORY_SIZE && code[address] == isCode && (isCode || address < romEnd))
+            ++address;
+
+        region.end = static_cast<uint16_t>(address);
+        analysis.regions.push_back(region);
+    }
+
+    return analysis;
+}
+
+bool UseStaticAnalysis(Chip8& chip8)
+{
+    chip8.staticCode = AnalyzeProgram(chip8).StaticCode();
+    return chip8.staticCode;
+}
+
+void WriteAnalysisJson(RomAnalysis const& analysis, std::ostream& out)
+{
+    static char const* const flowNames[] = {"next", "jump", "call", "return", "skip", "indirect", "exit"};
+
+    out << "{\n"
+        << "  \"quirks\": \"" << QuirkProfileName(analysis.quirks) << "\",\n"
+        << "  \"static_code\": " << (analysis.StaticCode() ? "true" : "false") << ",\n"
+        << "  \"writes_code\": " << (analysis.writesCode ? "true" : "false") << ",\n"
+        << "  \"entries\": [";
+    for (size_t i = 0; i < analysis.entries.size(); ++i)
+    {
+        out << (i ? ", " : "");
+        WriteAddress(out, analysis.entries[i]);
+    }
+
+    out << "],\n  \"indirect_jumps\": [";
+    for (size_t i = 0; i < analysis.indirectJumps.size(); ++i)
+    {
+        out << (i ? ", " : "");
+        WriteAddress(out, analysis.indirectJumps[i]);
+    }
+
+    out << "],\n  \"regions\": [";
+    for (size_t i = 0; i < analysis.regions.size(); ++i)
+    {
+        MemoryRegion const& region = analysis.regions[i];
+        out << (i ? ",\n" : "\n") << "    {\"first\": ";
+        WriteAddress(out, region.first);
+        out << ", \"end\": ";
+        WriteAddress(out, region.end);
+        out << ", \"kind\": \"" << (region.code ? "code" : "data") << "\"}";
+    }
+
+    out << "\n  ],\n  \"stores\": [";
+    for (size_t i = 0; i < analysis.stores.size(); ++i)
+    {
+        MemoryStore const& store = analysis.stores[i];
+        out << (i ? ",\n" : "\n") << "    {\"address\": ";
+        WriteAddress(out, store.address);
+        out << ", \"first\": ";
+        WriteAddress(out, store.first);
+        out << ", \"last\": ";
+        WriteAddress(out, store.last);
+        out << ", \"anywhere\": " << (store.anywhere ? "true" : "false")
+            << ", \"writes_code\": " << (store.writesCode ? "true" : "false") << "}";
+    }
+
+    out << "\n  ],\n  \"instructions\": [";
+    for (size_t i = 0; i < analysis.instructions.size(); ++i)
+    {
+        CodeInstruction const& instruction = analysis.instructions[i];
+        char opcode[8];
+        std::snprintf(opcode, sizeof(opcode), "%04X", instruction.opcode);
+
+        out << (i ? ",\n" : "\n") << "    {\"address\": ";
+        WriteAddress(out, instruction.address);
+        out << ", \"opcode\": \"" << opcode << "\", \"asm\": \"" << Disassemble(instruction.opcode, analysis.quirks)
+            << "\", \"flow\": \"" << flowNames[static_cast<int>(instruction.flow)] << "\", \"successors\": [";
+        for (unsigned int s = 0; s < instruction.successorCount; ++s)
+        {
+            out << (s ? ", " : "");
+            WriteAddress(out, instruction.successors[s]);
+        }
+        out << "]" << (instruction.unknown ? ", \"unknown\": true" : "") << "}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+void WriteAnalysisDot(RomAnalysis const& analysis, std::ostream& out)
+{
+    std::vector<CodeInstruction> const& instructions = analysis.instructions;
+
+    // Instruction at each address (-1 = none)
+    std::vector<int> at(MEMORY_SIZE, -1);
+    for (size_t i = 0; i < instructions.size(); ++i)
+        at[instructions[i].address] = static_cast<int>(i);
+
+    // Basic blocks start at the entries and at every address reached other than by falling
+    // through from the previous instruction
+    std::vector<unsigned int> predecessors(MEMORY_SIZE, 0);
+    std::vector<bool> leader(MEMORY_SIZE, false);
+    for (uint16_t entry : analysis.entries)
+        leader[entry] = true;
+
+    for (CodeInstruction const& instruction : instructions)
+    {
+        for (unsigned int s = 0; s < instruction.successorCount; ++s)
+        {
+            uint16_t successor = instruction.successors[s];
+            ++predecessors[successor];
+            if (instruction.flow != FlowKind::Next)
+                leader[successor] = true;
+        }
+    }
+
+    for (CodeInstruction const& instruction : instructions)
+    {
+        int previous = at[(instruction.address - 2u) & 0x0FFFu];
+        if (previous < 0 || instructions[previous].flow != FlowKind::Next || predecessors[instruction.address] != 1)
+            leader[instruction.address] = true;
+    }
+
+    // Stores that may overwrite code are highlighted
+    std::vector<bool> writesCode(MEMORY_SIZE, false);
+    for (MemoryStore const& store : analysis.stores)
+        writesCode[store.address] = store.writesCode;
+
+    out << "digraph program {\n"
+        << "  node [shape=box, fontname=\"monospace\"];\n";
+
+    for (CodeInstruction const& first : instructions)
+    {
+        if (!leader[first.address])
+            continue;
+
+        char text[64];
+        bool highlight = false;
+
+        std::snprintf(text, sizeof(text), "  b%03X [label=\"", first.address);
+        out << text;
+
+        // Until the next leader or a change of control flow
+        int current = at[first.address];
+        while (true)
+        {
+            CodeInstruction const& instruction = instructions[current];
+            highlight |= writesCode[instruction.address] || instruction.flow == FlowKind::IndirectJump;
+
+            std::snprintf(text, sizeof(text), "%03X: %s\\l", instruction.address,
+                          Disassemble(instruction.opcode, analysis.quirks).c_str());
+            out << text;
+
+            int next = at[(instruction.address + 2u) & 0x0FFFu];
+            if (instruction.flow != FlowKind::Next || next < 0 || leader[instructions[next].address])
+            {
+                out << '"' << (highlight ? ", color=red" : "") << "];\n";
+
+                static char const* const labels[] = {"", "", "call", "", "skip", "", ""};
+                for (unsigned int s = 0; s < instruction.successorCount; ++s)
+                {
+                    bool returnSite = instruction.flow == FlowKind::Call && s == 1;
+                    std::snprintf(text, sizeof(text), "  b%03X -> b%03X", first.address, instruction.successors[s]);
+                    out << text;
+                    if (returnSite)
+                        out << " [label=\"return\", style=dashed]";
+                    else if (*labels[static_cast<int>(instruction.flow)] && !(instruction.flow == FlowKind::Skip && s == 0))
+                        out << " [label=\"" << labels[static_cast<int>(instruction.flow)] << "\"]";
+                    out << ";\n";
+                }
+                break;
+            }
+
+            current = next;
+        }
+    }
+
+    out << "}\n";
+}
@@ -0,0 +1,84 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "Chip8.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Static analysis of the program in a machine's memory: follows the control flow from the PC
+// (and the return addresses on the stack) to find every reachable instruction, and bounds the
+// addresses I can hold at each of them to find which stores (Fx33, Fx55) can overwrite code.
+// When none can and every jump target is known, the program never modifies itself and the
+// engines can keep decoded instructions without watching the stores (Chip8::staticCode).
+//
+// The analysis assumes calls and returns pair up: a return continues after any reachable call.
+
+// How the execution continues after an instruction
+enum class FlowKind
+{
+    Next,         // The next instruction
+    Jump,         // 1nnn: target
+    Call,         // 2nnn: target, then the next instruction when the subroutine returns
+    Return,       // 00EE: the instruction after a call
+    Skip,         // The next instruction or the one after it
+    IndirectJump, // Bnnn: somewhere in [target, target + 255], not followed
+    Exit          // 00FD (SUPER-CHIP/XO-CHIP): the program ends
+};
+
+struct CodeInstruction
+{
+    uint16_t address{};
+    uint16_t opcode{};
+    FlowKind flow{FlowKind::Next};
+    uint16_t target{};            // Jump, Call, IndirectJump
+    uint16_t successors[2]{};     // Known addresses executed next (returns excluded)
+    unsigned int successorCount{};
+    bool unknown{};               // Not an instruction of the profile (executes as a NOP)
+};
+
+// A store instruction and the addresses it may write, [first, last]
+struct MemoryStore
+{
+    uint16_t address{};
+    uint16_t first{};
+    uint16_t last{};
+    bool anywhere{};  // I is unbounded or the store may run past the end of memory
+    bool writesCode{};
+};
+
+// A run of memory holding only code, or only data (ROM bytes that are never executed)
+struct MemoryRegion
+{
+    uint16_t first{};
+    uint16_t end{}; // One past the last byte
+    bool code{};
+};
+
+struct RomAnalysis
+{
+    QuirkProfile quirks{QuirkProfile::Default};
+    std::vector<uint16_t> entries;             // PC, then the return addresses on the stack
+    std::vector<CodeInstruction> instructions; // Every reachable instruction, by address
+    std::vector<MemoryStore> stores;           // Every reachable store, by address
+    std::vector<MemoryRegion> regions;         // By address
+    std::vector<uint16_t> indirectJumps;       // Reachable Bnnn, whose targets are not followed
+    bool writesCode{};                         // Some store may overwrite an instruction
+
+    // Whether the reachable code is known to be complete and never written
+    bool StaticCode() const { return indirectJumps.empty() && !writesCode; }
+};
+
+// Analyzes the program from the current state of chip8 (after LoadROM, or a restored snapshot).
+// ROM bytes in [START_ADDRESS, START_ADDRESS + romSize) that are not code are reported as data.
+RomAnalysis AnalyzeProgram(Chip8 const& chip8, size_t romSize = MAX_ROM_SIZE);
+
+// Analyzes the program and sets chip8.staticCode when it never modifies itself. Returns staticCode.
+bool UseStaticAnalysis(Chip8& chip8);
+
+// The analysis as JSON, or as a Graphviz graph of the basic blocks
+void WriteAnalysisJson(RomAnalysis const& analysis, std::ostream& out);
+void WriteAnalysisDot(RomAnalysis const& analysis, std::ostream& out);
+
+#endif
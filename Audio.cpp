@@ -0,0 +1,170 @@
+#include "Audio.hpp"
+#include "ByteOrder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    const size_t WAV_HEADER_SIZE = 44;
+
+    // Canonical 44 byte header of a 16-bit mono PCM WAV file with dataBytes of samples
+    void WavHeader(uint8_t* out, unsigned int sampleRate, uint32_t dataBytes)
+    {
+        memcpy(out, "RIFF", 4);
+        Put32(out + 4, 36 + dataBytes);
+        memcpy(out + 8, "WAVE", 4);
+        memcpy(out + 12, "fmt ", 4);
+        Put32(out + 16, 16);             // Size of the format chunk
+        Put16(out + 20, 1);              // PCM
+        Put16(out + 22, 1);              // Mono
+        Put32(out + 24, sampleRate);
+        Put32(out + 28, sampleRate * 2); // Bytes per second
+        Put16(out + 32, 2);              // Bytes per sample frame
+        Put16(out + 34, 16);             // Bits per sample
+        memcpy(out + 36, "data", 4);
+        Put32(out + 40, dataBytes);
+    }
+
+    bool HasPattern(Chip8 const& chip8)
+    {
+        for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; ++i)
+        {
+            if (chip8.audioPattern[i])
+                return true;
+        }
+        return false;
+    }
+}
+
+SampleRing::SampleRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+size_t SampleRing::Write(int16_t const* samples, size_t count)
+{
+    size_t writePos = head.load(std::memory_order_relaxed);
+    size_t readPos = tail.load(std::memory_order_acquire);
+
+    size_t room = buffer.size() - (writePos - readPos);
+    if (count > room)
+        count = room;
+
+    for (size_t i = 0; i < count; ++i)
+        buffer[(writePos + i) & mask] = samples[i];
+
+    // Publish the samples only once they are in the buffer
+    head.store(writePos + count, std::memory_order_release);
+    return count;
+}
+
+size_t SampleRing::Read(int16_t* samples, size_t count)
+{
+    size_t readPos = tail.load(std::memory_order_relaxed);
+    size_t writePos = head.load(std::memory_order_acquire);
+
+    if (count > writePos - readPos)
+        count = writePos - readPos;
+
+    for (size_t i = 0; i < count; ++i)
+        samples[i] = buffer[(readPos + i) & mask];
+
+    // Hand the slots back to the producer only once they were copied out
+    tail.store(readPos + count, std::memory_order_release);
+    return count;
+}
+
+WavAudioSink::WavAudioSink(char const* filename, unsigned int sampleRate)
+    : file(filename, std::ios::binary), sampleRate(sampleRate)
+{
+    // Placeholder header, the sizes are only known when the file is closed
+    uint8_t header[WAV_HEADER_SIZE];
+    WavHeader(header, sampleRate, 0);
+    file.write(reinterpret_cast<char const*>(header), sizeof(header));
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    Close();
+}
+
+void WavAudioSink::Write(int16_t const* samples, size_t count)
+{
+    bytes.resize(count * 2);
+    for (size_t i = 0; i < count; ++i)
+        Put16(&bytes[i * 2], static_cast<uint16_t>(samples[i]));
+
+    file.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    this->samples += count;
+}
+
+bool WavAudioSink::Close()
+{
+    if (!file.is_open())
+        return true;
+
+    uint8_t header[WAV_HEADER_SIZE];
+    WavHeader(header, sampleRate, static_cast<uint32_t>(samples * 2));
+    file.seekp(0);
+    file.write(reinterpret_cast<char const*>(header), sizeof(header));
+
+    bool written = static_cast<bool>(file);
+    file.close();
+    return written;
+}
+
+AudioStream::AudioStream(std::unique_ptr<AudioSink> sink, unsigned int sampleRate, unsigned int tickRate)
+    : sink(std::move(sink)), sampleRate(sampleRate), tickRate(tickRate)
+{
+    buffer.reserve(sampleRate / tickRate + 1);
+}
+
+void AudioStream::Tick(Chip8 const& chip8)
+{
+    // sampleRate / tickRate samples per period, the fractions add up across periods
+    remainder += sampleRate;
+    size_t count = remainder / tickRate;
+    remainder %= tickRate;
+
+    buffer.resize(count);
+
+    if (chip8.soundTimer == 0)
+    {
+        std::fill(buffer.begin(), buffer.end(), 0);
+    }
+    else if (chip8.quirks == QuirkProfile::XoChip && HasPattern(chip8))
+    {
+        // 128 one-bit samples played at 4000 * 2^((pitch - 64) / 48) Hz, 2^25 phase steps per bit
+        double rate = 4000.0 * std::pow(2.0, (chip8.pitch - 64) / 48.0);
+        uint32_t step = static_cast<uint32_t>(std::lround(rate * 33554432.0 / sampleRate));
+
+        for (size_t i = 0; i < count; ++i, patternPhase += step)
+        {
+            unsigned int bit = patternPhase >> 25u;
+            bool on = (chip8.audioPattern[bit / 8] >> (7 - bit % 8)) & 1u;
+            buffer[i] = on ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+        }
+        audibleSamples += count;
+    }
+    else
+    {
+        uint32_t step = static_cast<uint32_t>((static_cast<uint64_t>(BEEP_FREQUENCY) << 32u) / sampleRate);
+
+        for (size_t i = 0; i < count; ++i, beepPhase += step)
+            buffer[i] = (beepPhase >> 31u) ? -AUDIO_AMPLITUDE : AUDIO_AMPLITUDE;
+        audibleSamples += count;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        hash.Add16(static_cast<uint16_t>(buffer[i]));
+    samples += count;
+
+    sink->Write(buffer.data(), count);
+}
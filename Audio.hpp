@@ -0,0 +1,134 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "Chip8.hpp"
+#include "RomStore.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// Audio output: 16-bit signed mono samples
+const unsigned int DEFAULT_SAMPLE_RATE = 44100;
+
+// Samples per buffer of the audio device (lower = less latency, more risk of dropouts)
+const unsigned int DEFAULT_AUDIO_BUFFER = 512;
+
+// The CHIP-8 beep: a square wave, also played by XO-CHIP until a program loads a pattern
+const unsigned int BEEP_FREQUENCY = 440;
+const int16_t AUDIO_AMPLITUDE = 4096;
+
+// Lock-free single-producer/single-consumer ring of samples: the emulation thread writes,
+// the audio callback reads. Neither side waits, locks or allocates.
+class SampleRing
+{
+public:
+    // Holds capacity samples at least (rounded up to a power of two)
+    explicit SampleRing(size_t capacity);
+
+    // Producer: appends up to count samples and returns how many fit (a lagging reader
+    // makes the writer drop samples instead of adding latency)
+    size_t Write(int16_t const* samples, size_t count);
+
+    // Consumer: takes up to count samples and returns how many were buffered
+    size_t Read(int16_t* samples, size_t count);
+
+    size_t Capacity() const { return buffer.size(); }
+
+private:
+    std::vector<int16_t> buffer;
+    size_t mask;
+    std::atomic<size_t> head{}; // Samples written so far, only stored by the producer
+    std::atomic<size_t> tail{}; // Samples read so far, only stored by the consumer
+};
+
+// Destination of the rendered samples
+class AudioSink
+{
+public:
+    virtual ~AudioSink() {}
+    virtual void Write(int16_t const* samples, size_t count) = 0;
+};
+
+// Discards the samples: audio is rendered (and counted and hashed by AudioStream) without a sound card
+class NullAudioSink : public AudioSink
+{
+public:
+    void Write(int16_t const*, size_t) override {}
+};
+
+// Writes the samples to a 16-bit mono PCM WAV file
+class WavAudioSink : public AudioSink
+{
+public:
+    WavAudioSink(char const* filename, unsigned int sampleRate);
+    ~WavAudioSink() override;
+
+    bool IsOpen() const { return file.is_open(); }
+
+    void Write(int16_t const* samples, size_t count) override;
+
+    // Fills in the sizes in the header and closes the file. Returns false when a write failed.
+    bool Close();
+
+private:
+    std::ofstream file;
+    unsigned int sampleRate;
+    uint64_t samples{};
+    std::vector<uint8_t> bytes; // Little-endian staging buffer
+};
+
+// Feeds a SampleRing read by an audio callback (see Platform::OpenAudio)
+class RingAudioSink : public AudioSink
+{
+public:
+    explicit RingAudioSink(SampleRing& ring) : ring(ring) {}
+
+    void Write(int16_t const* samples, size_t count) override { dropped += count - ring.Write(samples, count); }
+
+    // Samples that did not fit in the ring
+    uint64_t Dropped() const { return dropped; }
+
+private:
+    SampleRing& ring;
+    uint64_t dropped{};
+};
+
+// Renders the sound of a machine one timer period at a time: set it as Chip8::audio and
+// Chip8::TickTimers calls Tick. While the sound timer is non-zero it plays the beep or, on
+// XO-CHIP once a program loaded a pattern (F002), the pattern bits at the pitch set by Fx3A;
+// otherwise silence. The tone is continuous from one period to the next.
+class AudioStream
+{
+public:
+    AudioStream(std::unique_ptr<AudioSink> sink, unsigned int sampleRate = DEFAULT_SAMPLE_RATE,
+                unsigned int tickRate = TIMER_FREQUENCY);
+
+    // Renders the samples of the timer period that ends into the sink
+    void Tick(Chip8 const& chip8);
+
+    AudioSink& Sink() { return *sink; }
+    unsigned int SampleRate() const { return sampleRate; }
+
+    // Samples rendered, samples with the sound on and a hash of all of them (FNV-1a), to check
+    // the audio of a run without listening to it
+    uint64_t Samples() const { return samples; }
+    uint64_t AudibleSamples() const { return audibleSamples; }
+    uint64_t Hash() const { return hash.Value(); }
+
+private:
+    std::unique_ptr<AudioSink> sink;
+    unsigned int sampleRate;
+    unsigned int tickRate;
+    unsigned int remainder{};   // Fraction of a sample carried over to the next period, in 1/tickRate
+    uint32_t beepPhase{};       // Position in the beep period, 2^32 = one period
+    uint32_t patternPhase{};    // Position in the pattern, 2^32 = 128 bits
+    std::vector<int16_t> buffer;
+    uint64_t samples{};
+    uint64_t audibleSamples{};
+    Fnv1a hash;
+};
+
+#endif
@@ -0,0 +1,398 @@
+// Microbenchmarks for the opcode handlers, instruction dispatch, OP_Dxyn, LoadROM and
+// Platform::Update. Results are printed as a table, or as JSON with --json so runs of
+// different releases can be compared by name.
+//
+// Build with the chip8bench CMake target, or next to the emulator sources:
+//   g++ -std=c++11 -O2 ./Benchmark.cpp ./Audio.cpp ./Chip8.cpp ./SwitchCore.cpp ./RomArchive.cpp ./RomStore.cpp ./Keymap.cpp ./Platform.cpp -o ./chip8bench -lSDL2
+// or without the SDL based benchmarks:
+//   g++ -std=c++11 -O2 -DCHIP8_NO_SDL ./Benchmark.cpp ./Audio.cpp ./Chip8.cpp ./SwitchCore.cpp ./RomArchive.cpp ./RomStore.cpp -o ./chip8bench
+
+#include "Chip8.hpp"
+#include "RomStore.hpp"
+#ifndef CHIP8_NO_SDL
+#include "Platform.hpp"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Keeps the compiler from optimizing away work whose result is never read
+    // (value escapes and all memory counts as read and written)
+    template <typename T>
+    inline void DoNotOptimize(T const& value)
+    {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    struct BenchSettings
+    {
+        double minTime = 0.1;  // Seconds per repetition
+        unsigned int repetitions = 5; // The median repetition is reported
+        std::string filter;    // Only run benchmarks whose name contains this
+        bool json = false;
+    };
+
+    struct BenchResult
+    {
+        std::string name;
+        uint64_t iterations{}; // Operations per repetition
+        double nsPerOp{};      // Median over the repetitions
+        double minNsPerOp{};   // Fastest repetition
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    BenchSettings settings;
+    std::vector<BenchResult> results;
+
+    // Runs body(n) (which must perform n operations) until a repetition takes at least
+    // settings.minTime, then records the median time per operation over the repetitions
+    template <typename Body>
+    void Bench(std::string const& name, Body body)
+    {
+        if (name.find(settings.filter) == std::string::npos)
+            return;
+
+        // Grow the batch size until one batch is long enough to time reliably
+        uint64_t iterations = 1;
+        while (true)
+        {
+            Clock::time_point start = Clock::now();
+            body(iterations);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (seconds >= settings.minTime || iterations >= (1ull << 40))
+                break;
+
+            double scale = seconds > 0.0 ? settings.minTime * 1.2 / seconds : 100.0;
+            iterations = static_cast<uint64_t>(iterations * std::min(std::max(scale, 2.0), 100.0));
+        }
+
+        std::vector<double> samples;
+        for (unsigned int i = 0; i < settings.repetitions; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            body(iterations);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            samples.push_back(seconds * 1e9 / iterations);
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        BenchResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = samples[samples.size() / 2];
+        result.minNsPerOp = samples.front();
+        results.push_back(result);
+
+        if (!settings.json)
+        {
+            std::printf("%-32s %10.2f ns/op %10.2f MIPS %12llu iterations\n", name.c_str(), result.nsPerOp,
+                        1e3 / result.nsPerOp, static_cast<unsigned long long>(iterations));
+        }
+    }
+
+    // Stack pointer of the benchmarked machine: both RET and CALL have a valid stack slot
+    const uint8_t BENCH_SP = 8;
+
+    // A machine in a state where every instruction is safe to execute repeatedly
+    void PrepareMachine(Chip8& chip8)
+    {
+        for (unsigned int i = 0; i < 16; ++i)
+            chip8.registers[i] = static_cast<uint8_t>(i * 17 + 3);
+
+        chip8.index = 0x300;
+        chip8.pc = START_ADDRESS;
+        for (unsigned int i = 0; i < 16; ++i)
+            chip8.stack[i] = START_ADDRESS;
+        chip8.sp = BENCH_SP;
+        chip8.keypad = 1u << 5;
+        chip8.randGen.seed(1);
+    }
+
+    // Calls one handler with a fixed opcode, n times
+    void BenchHandler(char const* name, Chip8::Chip8Func handler, uint16_t opcode)
+    {
+        Chip8 chip8;
+        PrepareMachine(chip8);
+        chip8.opcode = opcode;
+
+        Bench(std::string("op/") + name, [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                // CALL/RET move the stack pointer: start every call from the middle of the stack
+                chip8.sp = BENCH_SP;
+                DoNotOptimize(chip8);
+                ((chip8).*(handler))();
+            }
+            DoNotOptimize(chip8);
+        });
+    }
+
+    void BenchOpcodes()
+    {
+        // Opcodes read x = 1, y = 2 where they take registers
+        BenchHandler("00E0_CLS", &Chip8::OP_00E0, 0x00E0);
+        BenchHandler("00EE_RET", &Chip8::OP_00EE, 0x00EE);
+        BenchHandler("1nnn_JP", &Chip8::OP_1nnn, 0x1200);
+        BenchHandler("2nnn_CALL", &Chip8::OP_2nnn, 0x2200);
+        BenchHandler("3xkk_SE", &Chip8::OP_3xkk, 0x3114);
+        BenchHandler("4xkk_SNE", &Chip8::OP_4xkk, 0x4114);
+        BenchHandler("5xy0_SE", &Chip8::OP_5xy0, 0x5120);
+        BenchHandler("6xkk_LD", &Chip8::OP_6xkk, 0x6142);
+        BenchHandler("7xkk_ADD", &Chip8::OP_7xkk, 0x7101);
+        BenchHandler("8xy0_LD", &Chip8::OP_8xy0, 0x8120);
+        BenchHandler("8xy1_OR", &Chip8::OP_8xy1<DefaultQuirks>, 0x8121);
+        BenchHandler("8xy2_AND", &Chip8::OP_8xy2<DefaultQuirks>, 0x8122);
+        BenchHandler("8xy3_XOR", &Chip8::OP_8xy3<DefaultQuirks>, 0x8123);
+        BenchHandler("8xy4_ADD", &Chip8::OP_8xy4, 0x8124);
+        BenchHandler("8xy5_SUB", &Chip8::OP_8xy5, 0x8125);
+        BenchHandler("8xy6_SHR", &Chip8::OP_8xy6<DefaultQuirks>, 0x8126);
+        BenchHandler("8xy7_SUBN", &Chip8::OP_8xy7, 0x8127);
+        BenchHandler("8xyE_SHL", &Chip8::OP_8xyE<DefaultQuirks>, 0x812E);
+        BenchHandler("9xy0_SNE", &Chip8::OP_9xy0, 0x9120);
+        BenchHandler("Annn_LD", &Chip8::OP_Annn, 0xA300);
+        BenchHandler("Bnnn_JP", &Chip8::OP_Bnnn<DefaultQuirks>, 0xB200);
+        BenchHandler("Cxkk_RND", &Chip8::OP_Cxkk, 0xC1FF);
+        BenchHandler("Dxyn_DRW", &Chip8::OP_Dxyn<DefaultQuirks>, 0xD125);
+        BenchHandler("Ex9E_SKP", &Chip8::OP_Ex9E, 0xE19E);
+        BenchHandler("ExA1_SKNP", &Chip8::OP_ExA1, 0xE1A1);
+        BenchHandler("Fx07_LD", &Chip8::OP_Fx07, 0xF107);
+        BenchHandler("Fx0A_LD_K", &Chip8::OP_Fx0A, 0xF10A);
+        BenchHandler("Fx15_LD", &Chip8::OP_Fx15, 0xF115);
+        BenchHandler("Fx18_LD", &Chip8::OP_Fx18, 0xF118);
+        BenchHandler("Fx1E_ADD", &Chip8::OP_Fx1E, 0xF01E); // V0 = 3 keeps I inside memory for a while
+        BenchHandler("Fx29_LD_F", &Chip8::OP_Fx29, 0xF129);
+        BenchHandler("Fx33_LD_B", &Chip8::OP_Fx33, 0xF133);
+        BenchHandler("Fx55_LD", &Chip8::OP_Fx55<DefaultQuirks>, 0xFF55);
+        BenchHandler("Fx65_LD", &Chip8::OP_Fx65<DefaultQuirks>, 0xFF65);
+        BenchHandler("00Cn_SCD", &Chip8::OP_00Cn, 0x00C4);
+        BenchHandler("00FB_SCR", &Chip8::OP_00FB, 0x00FB);
+        BenchHandler("00FC_SCL", &Chip8::OP_00FC, 0x00FC);
+    }
+
+    // OP_Dxyn under different sprite heights, clipping/wrapping positions and display modes
+    void BenchSprites()
+    {
+        struct Case { char const* name; uint8_t x, y, height; QuirkProfile quirks; bool hires; uint8_t planes; };
+        Case const cases[] =
+        {
+            {"draw/h1_aligned", 8, 4, 1, QuirkProfile::Default, false, 1},
+            {"draw/h5_aligned", 8, 4, 5, QuirkProfile::Default, false, 1},
+            {"draw/h15_aligned", 8, 4, 15, QuirkProfile::Default, false, 1},
+            {"draw/h5_unaligned", 13, 4, 5, QuirkProfile::Default, false, 1},
+            {"draw/h5_wrap_right", 60, 4, 5, QuirkProfile::Default, false, 1},
+            {"draw/h15_wrap_bottom", 8, 25, 15, QuirkProfile::Default, false, 1},
+            {"draw/hires_h5_aligned", 8, 4, 5, QuirkProfile::SuperChip, true, 1},
+            {"draw/hires_16x16_straddle", 60, 20, 0, QuirkProfile::SuperChip, true, 1},
+            {"draw/hires_16x16_2_planes", 60, 20, 0, QuirkProfile::XoChip, true, 3},
+        };
+
+        for (Case const& c : cases)
+        {
+            Chip8 chip8(c.quirks);
+            PrepareMachine(chip8);
+            chip8.hires = c.hires;
+            chip8.planes = c.planes;
+            chip8.registers[1] = c.x;
+            chip8.registers[2] = c.y;
+            chip8.index = FONTSET_START_ADDRESS;
+            chip8.opcode = 0xD120 | c.height;
+
+            Chip8::Chip8Func draw = chip8.table[0xD];
+
+            Bench(c.name, [&](uint64_t n)
+            {
+                for (uint64_t i = 0; i < n; ++i)
+                {
+                    DoNotOptimize(chip8);
+                    ((chip8).*(draw))();
+                }
+                DoNotOptimize(chip8);
+            });
+        }
+    }
+
+    // Writes a straight-line loop of ALU instructions ending in a jump back to the start
+    void LoadLoopProgram(Chip8& chip8)
+    {
+        uint16_t const body[] = {0x6105, 0x7201, 0x8124, 0x8312, 0x8426, 0xA300, 0xF31E, 0x1200};
+
+        for (unsigned int i = 0; i < sizeof(body) / sizeof(body[0]); ++i)
+        {
+            chip8.memory[START_ADDRESS + 2 * i] = body[i] >> 8u;
+            chip8.memory[START_ADDRESS + 2 * i + 1] = body[i] & 0xFFu;
+        }
+
+        chip8.MemoryWritten(START_ADDRESS, sizeof(body));
+    }
+
+    // Cost of getting from the PC to the handler
+    void BenchDispatch()
+    {
+        Chip8 chip8;
+        PrepareMachine(chip8);
+        LoadLoopProgram(chip8);
+
+        // The original fetch + nested function table walk, for reference
+        Bench("dispatch/table", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                chip8.opcode = (chip8.memory[chip8.pc] << 8u) | chip8.memory[chip8.pc + 1];
+                chip8.pc += 2;
+                ((chip8).*(chip8.table[(chip8.opcode & 0xF000u) >> 12u]))();
+            }
+            DoNotOptimize(chip8);
+        });
+
+        // Decode cache
+        Bench("dispatch/cycle", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                chip8.Cycle();
+            DoNotOptimize(chip8);
+        });
+
+        // Whole blocks per dispatch, reported per instruction
+        Bench("dispatch/block", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; )
+                i += chip8.Step(Engine::Block, static_cast<unsigned int>(std::min<uint64_t>(n - i, MAX_BLOCK_LENGTH)));
+            DoNotOptimize(chip8);
+        });
+
+        // Fetch + switch decode, the differential reference core
+        Bench("dispatch/switch", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                chip8.Step(Engine::Switch, 1);
+            DoNotOptimize(chip8);
+        });
+    }
+
+    void BenchLoadROM()
+    {
+        char const* filename = "chip8bench_rom.tmp";
+
+        // A ROM filling all of program memory
+        {
+            std::ofstream file(filename, std::ios::binary);
+            for (unsigned int i = START_ADDRESS; i < MEMORY_SIZE; ++i)
+                file.put(static_cast<char>(i));
+        }
+
+        Chip8 chip8;
+        Bench("rom/load_3584", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                DoNotOptimize(chip8.LoadROM(filename));
+        });
+
+        RomStore store;
+        RomImage const* rom = store.AddFile(filename);
+        Bench("rom/load_mapped_3584", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                DoNotOptimize(chip8.LoadROM(rom->data, rom->size));
+        });
+
+        std::remove(filename);
+    }
+
+#ifndef CHIP8_NO_SDL
+    void BenchPlatform()
+    {
+        // Render without a visible window
+        setenv("SDL_VIDEODRIVER", "offscreen", 0);
+
+        Platform platform("CHIP-8 Benchmark", VIDEO_WIDTH, VIDEO_HEIGHT, HIRES_VIDEO_WIDTH, HIRES_VIDEO_HEIGHT);
+
+        uint64_t video[VIDEO_WORDS];
+        for (unsigned int i = 0; i < VIDEO_WORDS; ++i)
+            video[i] = 0x5555555555555555ull << (i & 1u);
+
+        Bench("platform/update_full", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                platform.Update(video, nullptr, VIDEO_WIDTH, VIDEO_HEIGHT, 0, VIDEO_HEIGHT);
+        });
+
+        Bench("platform/update_5_rows", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                platform.Update(video, nullptr, VIDEO_WIDTH, VIDEO_HEIGHT, 10, 5);
+        });
+
+        Bench("platform/update_hires_full", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                platform.Update(video, nullptr, HIRES_VIDEO_WIDTH, HIRES_VIDEO_HEIGHT, 0, HIRES_VIDEO_HEIGHT);
+        });
+
+        Bench("platform/update_hires_2_planes", [&](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                platform.Update(video, &video[VIDEO_PLANE_WORDS], HIRES_VIDEO_WIDTH, HIRES_VIDEO_HEIGHT, 0, HIRES_VIDEO_HEIGHT);
+        });
+    }
+#endif
+
+    void PrintJson()
+    {
+        std::printf("{\n  \"schema\": 1,\n  \"benchmarks\": [\n");
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            BenchResult const& r = results[i];
+            std::printf("    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"mips\": %.3f, \"iterations\": %llu}%s\n",
+                        r.name.c_str(), r.nsPerOp, r.minNsPerOp, 1e3 / r.nsPerOp,
+                        static_cast<unsigned long long>(r.iterations), i + 1 < results.size() ? "," : "");
+        }
+
+        std::printf("  ]\n}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0)
+            settings.json = true;
+        else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            settings.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            settings.minTime = std::stod(argv[++i]);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            settings.repetitions = std::max(1, std::stoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--json] [--filter <substring>] [--min-time <seconds>] [--repetitions <N>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    BenchOpcodes();
+    BenchSprites();
+    BenchDispatch();
+    BenchLoadROM();
+#ifndef CHIP8_NO_SDL
+    BenchPlatform();
+#endif
+
+    if (settings.json)
+        PrintJson();
+
+    return EXIT_SUCCESS;
+}
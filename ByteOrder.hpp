@@ -0,0 +1,41 @@
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <cstdint>
+
+// Little-endian field helpers of the binary file formats (snapshots, movies, ROM archives, WAV)
+
+inline void Put16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFFu;
+    out[1] = value >> 8u;
+}
+
+inline void Put32(uint8_t* out, uint32_t value)
+{
+    Put16(out, value & 0xFFFFu);
+    Put16(out + 2, value >> 16u);
+}
+
+inline void Put64(uint8_t* out, uint64_t value)
+{
+    Put32(out, value & 0xFFFFFFFFu);
+    Put32(out + 4, value >> 32u);
+}
+
+inline uint16_t Get16(uint8_t const* in)
+{
+    return in[0] | (in[1] << 8u);
+}
+
+inline uint32_t Get32(uint8_t const* in)
+{
+    return Get16(in) | (static_cast<uint32_t>(Get16(in + 2)) << 16u);
+}
+
+inline uint64_t Get64(uint8_t const* in)
+{
+    return Get32(in) | (static_cast<uint64_t>(Get32(in + 4)) << 32u);
+}
+
+#endif
@@ -1,8 +1,54 @@
 #include "Chip8.hpp"
+#include "Audio.hpp"
+#include "Profile.hpp"
+#include <cstring>
+
+// FONTSET Sprites in memory (Each 5 bytes)
+uint8_t const fontset[FONTSET_SIZE] = 
+{
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+// 8x10 FONTSET Sprites in memory (Each 10 bytes)
+uint8_t const bigFontset[BIG_FONTSET_SIZE] =
+{
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
 
 // Constructor
-Chip8::Chip8()
-    : randGen(std::chrono::system_clock::now().time_since_epoch().count())
+Chip8::Chip8(QuirkProfile quirks)
+    : randGen(std::chrono::system_clock::now().time_since_epoch().count()),
+      quirks(quirks)
 {
     // Set the PC to starting address of the instructions
     pc = START_ADDRESS;
@@ -28,26 +74,25 @@ Chip8::Chip8()
     table[0x8] = &Chip8::Table8;
     table[0x9] = &Chip8::OP_9xy0;
     table[0xA] = &Chip8::OP_Annn;
-    table[0xB] = &Chip8::OP_Bnnn;
     table[0xC] = &Chip8::OP_Cxkk;
-    table[0xD] = &Chip8::OP_Dxyn;
     table[0xE] = &Chip8::TableE;
     table[0xF] = &Chip8::TableF;
 
-    // table0 assignments
-    table0[0x0] = &Chip8::OP_00E0;
-    table0[0xE] = &Chip8::OP_00EE;
+    // table0 assignments (only the low nibble used to be decoded, so every 0x?0 is CLS
+    // and every 0x?E is RET, unless a profile installs an extended opcode there)
+    for (unsigned int low = 0; low <= 0xFF; ++low)
+    {
+        if ((low & 0x0Fu) == 0x0u)
+            table0[low] = &Chip8::OP_00E0;
+        else if ((low & 0x0Fu) == 0xEu)
+            table0[low] = &Chip8::OP_00EE;
+    }
 
     // table8 assignments
     table8[0x0] = &Chip8::OP_8xy0;
-    table8[0x1] = &Chip8::OP_8xy1;
-    table8[0x2] = &Chip8::OP_8xy2;
-    table8[0x3] = &Chip8::OP_8xy3;
     table8[0x4] = &Chip8::OP_8xy4;
     table8[0x5] = &Chip8::OP_8xy5;
-    table8[0x6] = &Chip8::OP_8xy6;
     table8[0x7] = &Chip8::OP_8xy7;
-    table8[0xE] = &Chip8::OP_8xyE;
 
     // tableE assignments
     tableE[0x1] = &Chip8::OP_ExA1;
@@ -61,35 +106,168 @@ Chip8::Chip8()
     tableF[0x1E] = &Chip8::OP_Fx1E;    
     tableF[0x29] = &Chip8::OP_Fx29;    
     tableF[0x33] = &Chip8::OP_Fx33;    
-    tableF[0x55] = &Chip8::OP_Fx55;    
-    tableF[0x65] = &Chip8::OP_Fx65;    
+
+    // Handlers that depend on the quirk profile (0xB, 0xD, 8xy1/2/3/6/E, Fx55, Fx65)
+    switch (quirks)
+    {
+        case QuirkProfile::Default: InstallQuirkHandlers<DefaultQuirks>(); break;
+        case QuirkProfile::CosmacVip: InstallQuirkHandlers<CosmacVipQuirks>(); break;
+        case QuirkProfile::Chip48: InstallQuirkHandlers<Chip48Quirks>(); break;
+        case QuirkProfile::SuperChip: InstallQuirkHandlers<SuperChipQuirks>(); break;
+        case QuirkProfile::XoChip: InstallQuirkHandlers<XoChipQuirks>(); break;
+    }
+
+    // Load the hi-res digits (Fx30) next to the regular ones
+    if (HasExtendedDisplay())
+    {
+        for (unsigned int i = 0; i < BIG_FONTSET_SIZE; ++i)
+            memory[BIG_FONTSET_START_ADDRESS + i] = bigFontset[i];
+    }
+}
+
+template <typename Quirks>
+void Chip8::InstallQuirkHandlers()
+{
+    table[0xB] = &Chip8::OP_Bnnn<Quirks>;
+    table[0xD] = &Chip8::OP_Dxyn<Quirks>;
+
+    table8[0x1] = &Chip8::OP_8xy1<Quirks>;
+    table8[0x2] = &Chip8::OP_8xy2<Quirks>;
+    table8[0x3] = &Chip8::OP_8xy3<Quirks>;
+    table8[0x6] = &Chip8::OP_8xy6<Quirks>;
+    table8[0xE] = &Chip8::OP_8xyE<Quirks>;
+
+    tableF[0x55] = &Chip8::OP_Fx55<Quirks>;
+    tableF[0x65] = &Chip8::OP_Fx65<Quirks>;
+
+    switchCycle = &Chip8::SwitchCycle<Quirks>;
+
+    if (Quirks::extendedDisplay)
+    {
+        for (unsigned int n = 0; n <= 0xF; ++n)
+            table0[0xC0 | n] = &Chip8::OP_00Cn;
+
+        table0[0xFB] = &Chip8::OP_00FB;
+        table0[0xFC] = &Chip8::OP_00FC;
+        table0[0xFD] = &Chip8::OP_00FD;
+        table0[0xFE] = &Chip8::OP_00FE;
+        table0[0xFF] = &Chip8::OP_00FF;
+
+        tableF[0x30] = &Chip8::OP_Fx30;
+    }
+
+    if (Quirks::bitPlanes)
+    {
+        for (unsigned int n = 0; n <= 0xF; ++n)
+            table0[0xD0 | n] = &Chip8::OP_00Dn;
+
+        tableF[0x01] = &Chip8::OP_Fn01;
+        tableF[0x02] = &Chip8::OP_F002;
+        tableF[0x3A] = &Chip8::OP_Fx3A;
+    }
+}
+
+bool ParseQuirkProfile(char const* name, QuirkProfile& profile)
+{
+    if (std::strcmp(name, "default") == 0)
+        profile = QuirkProfile::Default;
+    else if (std::strcmp(name, "vip") == 0)
+        profile = QuirkProfile::CosmacVip;
+    else if (std::strcmp(name, "chip48") == 0)
+        profile = QuirkProfile::Chip48;
+    else if (std::strcmp(name, "schip") == 0)
+        profile = QuirkProfile::SuperChip;
+    else if (std::strcmp(name, "xochip") == 0)
+        profile = QuirkProfile::XoChip;
+    else
+        return false;
+
+    return true;
+}
+
+char const* QuirkProfileName(QuirkProfile profile)
+{
+    switch (profile)
+    {
+        case QuirkProfile::Default: return "default";
+        case QuirkProfile::CosmacVip: return "vip";
+        case QuirkProfile::Chip48: return "chip48";
+        case QuirkProfile::SuperChip: return "schip";
+        case QuirkProfile::XoChip: return "xochip";
+    }
+
+    return "unknown";
+}
+
+bool ParseEngine(char const* name, Engine& engine)
+{
+    if (std::strcmp(name, "interpreter") == 0)
+        engine = Engine::Interpreter;
+    else if (std::strcmp(name, "block") == 0)
+        engine = Engine::Block;
+    else if (std::strcmp(name, "switch") == 0)
+        engine = Engine::Switch;
+    else
+        return false;
+
+    return true;
+}
+
+char const* EngineName(Engine engine)
+{
+    switch (engine)
+    {
+        case Engine::Interpreter: return "interpreter";
+        case Engine::Block: return "block";
+        case Engine::Switch: return "switch";
+    }
+
+    return "unknown";
 }
 
 // Function to load ROM contents into the memory for execution
 
-void Chip8::LoadROM(char const* filename) 
+bool Chip8::LoadROM(char const* filename) 
 {
     // Open the file as a binary file and go to the end of the file
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
 
     if (file.is_open())
     {
-        std::ios::streampos size = file.tellg(); // The position at the end of the file is it's size
+        std::streampos size = file.tellg(); // The position at the end of the file is it's size
 
-        char* buffer = new char[size]; // Create a buffer to store the contents of rom
+        // Anything past the end of memory would be lost (or overwrite something else)
+        if (size < 0 || size > static_cast<std::streamoff>(MAX_ROM_SIZE))
+            return false;
 
         file.seekg(0, std::ios::beg); // Go to the beginning of the file
-        file.read(buffer, size); // Read the file from the beginning in the buffer
 
-        file.close();
+        // Read the contents of the ROM straight into memory
+        file.read(reinterpret_cast<char*>(&memory[START_ADDRESS]), size);
 
-        //Load the contents of the ROM to memory
-        for (long i = 0; i < size; ++i)
-            memory[START_ADDRESS + i] = buffer[i];
+        // The program memory changed, forget everything decoded so far and known about it
+        MemoryWritten(0, MEMORY_SIZE);
+        staticCode = false;
 
-        delete[] buffer; // Free up buffer space
+        return true;
     }
-    
+
+    return false;
+}
+
+bool Chip8::LoadROM(uint8_t const* data, size_t size)
+{
+    if (size > MAX_ROM_SIZE)
+        return false;
+
+    if (size > 0)
+        memcpy(&memory[START_ADDRESS], data, size);
+
+    // The program memory changed, forget everything decoded so far and known about it
+    MemoryWritten(0, MEMORY_SIZE);
+    staticCode = false;
+
+    return true;
 }
 
 // Instructions
@@ -98,8 +276,8 @@ void Chip8::OP_NULL(){}
 
 void Chip8::OP_00E0()
 {
-    // Clear the display
-    memset(video, 0, sizeof(video));
+    // Clear the display (the selected planes of it)
+    ClearPlanes(planes);
 }
 
 void Chip8::OP_00EE()
@@ -186,6 +364,7 @@ void Chip8::OP_8xy0()
     registers[x] = registers[y];
 }
 
+template <typename Quirks>
 void Chip8::OP_8xy1()
 {
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
@@ -193,8 +372,13 @@ void Chip8::OP_8xy1()
 
     // OR Register Vx with value of Register Vy
     registers[x] |= registers[y];
+
+    // The COSMAC VIP clobbers VF in its logic routines
+    if (Quirks::logicResetsVf)
+        registers[0xF] = 0;
 }
 
+template <typename Quirks>
 void Chip8::OP_8xy2()
 {
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
@@ -202,8 +386,13 @@ void Chip8::OP_8xy2()
 
     // AND Register Vx with value of Register Vy
     registers[x] &= registers[y];
+
+    // The COSMAC VIP clobbers VF in its logic routines
+    if (Quirks::logicResetsVf)
+        registers[0xF] = 0;
 }
 
+template <typename Quirks>
 void Chip8::OP_8xy3()
 {
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
@@ -211,6 +400,10 @@ void Chip8::OP_8xy3()
 
     // XOR Register Vx with value of Register Vy
     registers[x] ^= registers[y];
+
+    // The COSMAC VIP clobbers VF in its logic routines
+    if (Quirks::logicResetsVf)
+        registers[0xF] = 0;
 }
 
 void Chip8::OP_8xy4()
@@ -220,13 +413,11 @@ void Chip8::OP_8xy4()
 
     uint16_t sum = registers[x] + registers[y]; // Vx + Vy
 
-    if (sum > 255U)
-        registers[0xF] = 1; // if overflow, then Vf = 1 (Carry)
-    else
-        registers[0xF] = 0;        
+    uint8_t carry = sum > 255U ? 1 : 0; // if overflow, then Vf = 1 (Carry)
 
-    // Load Register Vx with Least significant 8 bits of sum
+    // Load Register Vx with Least significant 8 bits of sum, then the flag (it wins when x is F)
     registers[x] = sum & 0xFFu;
+    registers[0xF] = carry;
 }
 
 void Chip8::OP_8xy5()
@@ -234,23 +425,27 @@ void Chip8::OP_8xy5()
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
 
-    if (registers[x] > registers[y])
-        registers[0xF] = 1; // if Vx > Vy, set Vf to 1 (not borrow)
-    else
-        registers[0xF] = 0;        
+    uint8_t notBorrow = registers[x] > registers[y] ? 1 : 0; // if Vx > Vy, set Vf to 1 (not borrow)
 
-    // Load Register Vx with Vx - Vy
+    // Load Register Vx with Vx - Vy, then the flag (it wins when x is F)
     registers[x] -= registers[y];
+    registers[0xF] = notBorrow;
 }
 
+template <typename Quirks>
 void Chip8::OP_8xy6()
 {
+    uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
 
-    registers[0xF] = (registers[x] & 0x1u); // Store Least Significant bit of Vx in Vf
+    // The COSMAC VIP shifts Vy into Vx, later interpreters shift Vx in place
+    uint8_t source = Quirks::shiftUsesVy ? registers[y] : registers[x];
 
-    // Right shift value of Register Vx by 1
-    registers[x] >>= 1;
+    uint8_t shiftedOut = source & 0x1u; // Least Significant bit of the source goes to Vf
+
+    // Right shift the source by 1 into Register Vx, then the flag (it wins when x is F)
+    registers[x] = source >> 1;
+    registers[0xF] = shiftedOut;
 }
 
 void Chip8::OP_8xy7()
@@ -258,23 +453,27 @@ void Chip8::OP_8xy7()
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
 
-    if (registers[y] > registers[x])
-        registers[0xF] = 1; // if Vy > Vx, set Vf to 1 (not borrow)
-    else
-        registers[0xF] = 0;        
+    uint8_t notBorrow = registers[y] > registers[x] ? 1 : 0; // if Vy > Vx, set Vf to 1 (not borrow)
 
-    // Load Register Vx with Vy - Vx
+    // Load Register Vx with Vy - Vx, then the flag (it wins when x is F)
     registers[x] = registers[y] - registers[x];
+    registers[0xF] = notBorrow;
 }
 
+template <typename Quirks>
 void Chip8::OP_8xyE()
 {
+    uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
 
-    registers[0xF] = (registers[x] & 0x80u); // Store Most Significant bit of Vx in Vf
+    // The COSMAC VIP shifts Vy into Vx, later interpreters shift Vx in place
+    uint8_t source = Quirks::shiftUsesVy ? registers[y] : registers[x];
+
+    uint8_t shiftedOut = source >> 7u; // Most Significant bit of the source goes to Vf
 
-    // Left shift value of Register Vx by 1
-    registers[x] <<= 1;
+    // Left shift the source by 1 into Register Vx, then the flag (it wins when x is F)
+    registers[x] = source << 1;
+    registers[0xF] = shiftedOut;
 }
 
 void Chip8::OP_9xy0()
@@ -295,11 +494,13 @@ void Chip8::OP_Annn()
   index = address; 
 }
 
+template <typename Quirks>
 void Chip8::OP_Bnnn()
 {
-  // Set PC = V0 + address (nnn)       
+  // Set PC = V0 + address (nnn), CHIP-48 and SUPER-CHIP use Vx (x = top nibble of nnn) instead
   uint16_t address = opcode & 0x0FFFu;
-  pc = registers[0] + address;  
+  uint8_t base = Quirks::jumpUsesVx ? registers[(opcode & 0x0F00u) >> 8u] : registers[0];
+  pc = base + address;
 }
 
 void Chip8::OP_Cxkk()
@@ -311,64 +512,76 @@ void Chip8::OP_Cxkk()
 
 }
 
+template <typename Quirks>
 void Chip8::OP_Dxyn()
 {
     uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
     uint8_t height = opcode & 0x000Fu;
 
+    // Hi-res, 16x16 sprites and bit planes take the general path
+    if (Quirks::extendedDisplay)
+    {
+        DrawExtendedSprite(Quirks::clipSprites);
+        return;
+    }
+
     // Wrap around if x and y positions exceed screen width and height
     uint8_t xPos = registers[x] % VIDEO_WIDTH;
     uint8_t yPos = registers[y] % VIDEO_HEIGHT;
 
-    //Set collision = 0 initially in VF
-    registers[0xF] = 0;
+    // Clipping interpreters drop the rows below the bottom edge
+    if (Quirks::clipSprites && yPos + height > VIDEO_HEIGHT)
+        height = VIDEO_HEIGHT - yPos;
+
+    // Rows touched by the sprite (wrapping past the bottom touches the top rows as well)
+    if (height > 0)
+    {
+        if (yPos + height <= VIDEO_HEIGHT)
+            MarkRowsDirty(yPos, yPos + height - 1);
+        else
+            MarkRowsDirty(0, VIDEO_HEIGHT - 1);
+    }
+
+    // Every sprite row is 8 pixels wide, so it is drawn with a single shift and XOR per row
+    uint64_t collision = 0;
 
-    //Iterating rows = height and columns = 8 (Fixed for sprites)
     for (unsigned int row = 0; row < height; ++row)
     {
-        uint8_t spriteByte = memory[index + row];
+        // Sprite row aligned to column 0 (the most significant bit)
+        uint64_t spriteRow = static_cast<uint64_t>(memory[index + row]) << 56u;
 
-        for (unsigned int col = 0; col < 8; ++col) 
-        {
-            uint8_t spritePixel = spriteByte & (0x80u >> col);
+        // Move it to xPos, the columns falling off the right edge wrap around to the left edge
+        // (or are dropped when clipping)
+        uint64_t line = (spriteRow >> xPos) | (!Quirks::clipSprites && xPos ? spriteRow << (VIDEO_WIDTH - xPos) : 0);
 
-            // Applied a fix by limiting the position inside the memory to avoid segmentation fault 11 
-            uint32_t* screenPixel = &video[((yPos + row) * VIDEO_WIDTH + (xPos + col))%(VIDEO_HEIGHT * VIDEO_WIDTH)];
+        uint64_t& screenRow = video[(yPos + row) % VIDEO_HEIGHT];
 
-            // If Sprite Pixel is on, then there is possibility of collison
-            if (spritePixel)
-            {
-                // If Screen Pixel is on, then set VF = 1 (collision occured)
-                if(*screenPixel == 0xFFFFFFFF) 
-                {
-                    registers[0xF] = 1;
-                }
-
-                // XOR the Screen Pixel with 0xFFFFFFFF (as Pixel can be 0x00000000 or 0xFFFFFFFF in our case)
-                *screenPixel ^= 0xFFFFFFFF;
-            }
-        }
-    }  
+        // A pixel that is on in both the screen and the sprite is a collision
+        collision |= screenRow & line;
+
+        // XOR the sprite onto the screen
+        screenRow ^= line;
+    }
 
+    // VF = 1 if any pixel was erased (collision occured)
+    registers[0xF] = collision ? 1 : 0;
 }
 
 void Chip8::OP_Ex9E()
 {
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
-    uint8_t key = registers[x];
 
-    if(keypad[key])
+    if (KeyDown(registers[x]))
         pc += 2; // Skip the next instruction if key in Vx is pressed
 }
 
 void Chip8::OP_ExA1()
 {
     uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
-    uint8_t key = registers[x];
 
-    if(!keypad[key])
-        pc += 2; // Skip the next instruction if key in Vx is not pressed    
+    if (!KeyDown(registers[x]))
+        pc += 2; // Skip the next instruction if key in Vx is not pressed
 }
 
 void Chip8::OP_Fx07()
@@ -380,80 +593,21 @@ void Chip8::OP_Fx07()
 
 void Chip8::OP_Fx0A()
 {
-   uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
-
-   // Wait for a key press and then store the value of the key in Vx
-   // Easiest way to do this is to keep PC on the same instruction by
-   // decrementing it by 2 whenever a key is not pressed
-
-   if (keypad[0])
-   {
-    registers[x] = 0;
-   }
-   else if (keypad[1])
-   {
-       registers[x] = 1;
-   } 
-      else if (keypad[2])
-   {
-       registers[x] = 2;
-   } 
-   else if (keypad[3])
-   {
-       registers[x] = 3;
-   } 
-   else if (keypad[4])
-   {
-       registers[x] = 4;
-   } 
-   else if (keypad[5])
-   {
-       registers[x] = 5;
-   } 
-   else if (keypad[6])
-   {
-       registers[x] = 6;
-   } 
-   else if (keypad[7])
-   {
-       registers[x] = 7;
-   } 
-   else if (keypad[8])
-   {
-       registers[x] = 8;
-   } 
-   else if (keypad[9])
-   {
-       registers[x] = 9;
-   } 
-   else if (keypad[10])
-   {
-       registers[x] = 10;
-   } 
-   else if (keypad[11])
-   {
-       registers[x] = 11;
-   } 
-   else if (keypad[12])
-   {
-       registers[x] = 12;
-   } 
-   else if (keypad[13])
-   {
-       registers[x] = 13;
-   } 
-   else if (keypad[14])
-   {
-       registers[x] = 14;
-   } 
-   else if (keypad[15])
-   {
-       registers[x] = 15;
-   } 
-    else
+    uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
+
+    // Wait for a key press and then store the value of the key in Vx (the lowest one when
+    // several are held). Waiting keeps PC on the same instruction by decrementing it by 2.
+    if (keypad == 0)
     {
         pc -= 2;
+        return;
     }
+
+    uint8_t key = 0;
+    while (!((keypad >> key) & 1u))
+        ++key;
+
+    registers[x] = key;
 }
 
 void Chip8::OP_Fx15()
@@ -498,8 +652,11 @@ void Chip8::OP_Fx33()
     value /= 10;
 
     memory[index] = value % 10; // Hundreds place
+
+    StoreWritten(index, 3);
 }
 
+template <typename Quirks>
 void Chip8::OP_Fx55()
 {
     // Store registers V0 through Vx in memory starting at location I (Index)
@@ -507,8 +664,17 @@ void Chip8::OP_Fx55()
 
     for (uint8_t i = 0; i <= x; ++i)
         memory[index + i] = registers[i];
+
+    StoreWritten(index, x + 1);
+
+    // Older interpreters leave I pointing past (or at the last of) the stored registers
+    if (Quirks::index == IndexQuirk::AddX)
+        index += x;
+    else if (Quirks::index == IndexQuirk::AddXPlus1)
+        index += x + 1;
 }
 
+template <typename Quirks>
 void Chip8::OP_Fx65()
 {
     // Read registers V0 through Vx from memory starting at location I (Index)
@@ -516,18 +682,464 @@ void Chip8::OP_Fx65()
 
     for (uint8_t i = 0; i <= x; ++i)
         registers[i] = memory[index + i];
-} 
+
+    // Older interpreters leave I pointing past (or at the last of) the loaded registers
+    if (Quirks::index == IndexQuirk::AddX)
+        index += x;
+    else if (Quirks::index == IndexQuirk::AddXPlus1)
+        index += x + 1;
+}
+
+void Chip8::OP_00Cn()
+{
+    // Scroll the display down by n rows
+    ScrollDown(opcode & 0x000Fu);
+}
+
+void Chip8::OP_00Dn()
+{
+    // Scroll the display up by n rows
+    ScrollUp(opcode & 0x000Fu);
+}
+
+void Chip8::OP_00FB()
+{
+    // Scroll the display right by 4 pixels
+    ScrollRight4();
+}
+
+void Chip8::OP_00FC()
+{
+    // Scroll the display left by 4 pixels
+    ScrollLeft4();
+}
+
+void Chip8::OP_00FD()
+{
+    // Exit the interpreter: stay on this instruction forever
+    pc -= 2;
+}
+
+void Chip8::OP_00FE()
+{
+    // Switch to the 64x32 mode, which starts with a clear screen
+    ClearPlanes((1u << VIDEO_PLANES) - 1);
+    hires = false;
+    MarkRowsDirty(0, VIDEO_HEIGHT - 1);
+}
+
+void Chip8::OP_00FF()
+{
+    // Switch to the 128x64 mode, which starts with a clear screen
+    ClearPlanes((1u << VIDEO_PLANES) - 1);
+    hires = true;
+    MarkRowsDirty(0, HIRES_VIDEO_HEIGHT - 1);
+}
+
+void Chip8::OP_Fn01()
+{
+    // Select the planes drawn, cleared and scrolled by the following instructions
+    uint8_t n = (opcode & 0x0F00u) >> 8u;
+    planes = n & ((1u << VIDEO_PLANES) - 1);
+}
+
+void Chip8::OP_F002()
+{
+    // Load the audio pattern from memory[I, I + 16)
+    for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; ++i)
+        audioPattern[i] = memory[(index + i) & (MEMORY_SIZE - 1)];
+}
+
+void Chip8::OP_Fx3A()
+{
+    // Set the playback rate of the audio pattern
+    uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
+    pitch = registers[x];
+}
+
+void Chip8::OP_Fx30()
+{
+    // I = Location of hi-res sprite for digit Vx
+    uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
+    uint8_t digit = registers[x] & 0x0Fu;
+    index = BIG_FONTSET_START_ADDRESS + (10 * digit); // Because each digit occupies 10 Bytes
+}
+
+// Instantiate the quirk dependent handlers for every profile, so they can be named outside this file
+#define INSTANTIATE_QUIRK_HANDLERS(Quirks) \
+    template void Chip8::OP_8xy1<Quirks>(); \
+    template void Chip8::OP_8xy2<Quirks>(); \
+    template void Chip8::OP_8xy3<Quirks>(); \
+    template void Chip8::OP_8xy6<Quirks>(); \
+    template void Chip8::OP_8xyE<Quirks>(); \
+    template void Chip8::OP_Bnnn<Quirks>(); \
+    template void Chip8::OP_Dxyn<Quirks>(); \
+    template void Chip8::OP_Fx55<Quirks>(); \
+    template void Chip8::OP_Fx65<Quirks>();
+
+INSTANTIATE_QUIRK_HANDLERS(DefaultQuirks)
+INSTANTIATE_QUIRK_HANDLERS(CosmacVipQuirks)
+INSTANTIATE_QUIRK_HANDLERS(Chip48Quirks)
+INSTANTIATE_QUIRK_HANDLERS(SuperChipQuirks)
+INSTANTIATE_QUIRK_HANDLERS(XoChipQuirks)
+
+#undef INSTANTIATE_QUIRK_HANDLERS
 
 void Chip8::Cycle()
 {
-    // Fetch
-    opcode = (memory[pc] << 8u) | memory[pc + 1];
+    // Fetch the pre-decoded instruction, decoding it on first use
+    DecodedInstruction& instruction = decodeCache[pc & 0x0FFFu];
+
+    if (!instruction.handler)
+        Decode(pc & 0x0FFFu);
+
+    opcode = instruction.opcode;
+    CHIP8_PROFILE_INSTRUCTION(profile, pc, opcode);
 
     // Increment PC by 2
     pc += 2;
 
-    // Decode & Execute
-    ((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+    // Execute
+    ((*this).*(instruction.handler))();
+}
+
+unsigned int Chip8::RunBlock(unsigned int maxCycles)
+{
+    uint16_t start = pc & 0x0FFFu;
+
+    unsigned int length = blockLength[start];
+    if (!length)
+        length = BuildBlock(start);
+
+    // Stop early when the budget ends inside the block
+    if (length > maxCycles)
+        length = maxCycles;
+
+    // Only the last instruction of a block can move the PC anywhere but forward
+    // or write code, so the whole block runs from the decode cache unchecked
+    DecodedInstruction const* instruction = &decodeCache[start];
+
+    for (unsigned int i = 0; i < length; ++i, instruction += 2)
+    {
+        opcode = instruction->opcode;
+        CHIP8_PROFILE_INSTRUCTION(profile, pc, opcode);
+        pc += 2;
+        ((*this).*(instruction->handler))();
+    }
+
+    return length;
+}
+
+// Instructions that end a block: they change the control flow or may write code
+static bool EndsBlock(uint16_t opcode, bool staticCode)
+{
+    switch ((opcode & 0xF000u) >> 12u)
+    {
+        case 0x0: return (opcode & 0x000Fu) == 0xEu || IsExit(opcode); // RET, EXIT (table0 aliases)
+        case 0x1: case 0x2: case 0xB: return true;           // JP, CALL, JP V0
+        case 0x3: case 0x4: case 0x5: case 0x9: return true; // Skips
+        case 0xE: return true;                               // Key skips
+        case 0xF:
+        {
+            uint8_t low = opcode & 0x00FFu;
+            return low == 0x0Au || (!staticCode && (low == 0x33u || low == 0x55u)); // Key wait, memory writes
+        }
+    }
+
+    return false;
+}
+
+unsigned int Chip8::BuildBlock(uint16_t address)
+{
+    unsigned int length = 0;
+    unsigned int current = address;
+
+    while (true)
+    {
+        if (!decodeCache[current].handler)
+            Decode(current);
+
+        uint16_t instruction = decodeCache[current].opcode;
+
+        // A jump to itself (or EXIT) starts its own block, so a headless run sees it before executing it
+        if (length > 0 && (instruction == (0x1000u | current) || IsExit(instruction)))
+            break;
+
+        ++length;
+        current += 2;
+
+        // The next instruction has to be fully inside memory to join the block
+        if (EndsBlock(instruction, staticCode) || length == MAX_BLOCK_LENGTH || current > MEMORY_SIZE - 2)
+            break;
+    }
+
+    blockLength[address] = length;
+    return length;
+}
+
+void Chip8::Decode(uint16_t address)
+{
+    DecodedInstruction& instruction = decodeCache[address];
+
+    instruction.opcode = (memory[address] << 8u) | memory[(address + 1u) & 0x0FFFu];
+
+    // Resolve the nested tables once instead of on every execution
+    Chip8Func handler = table[(instruction.opcode & 0xF000u) >> 12u];
+
+    if (handler == &Chip8::Table0)
+        handler = table0[instruction.opcode & 0x00FFu];
+    else if (handler == &Chip8::Table8)
+        handler = table8[instruction.opcode & 0x000Fu];
+    else if (handler == &Chip8::TableE)
+        handler = tableE[instruction.opcode & 0x000Fu];
+    else if (handler == &Chip8::TableF)
+        handler = (instruction.opcode & 0x00FFu) <= 0x65u ? tableF[instruction.opcode & 0x00FFu] : nullptr;
+
+    // Holes in the tables are unknown opcodes, which do nothing
+    instruction.handler = handler ? handler : &Chip8::OP_NULL;
+}
+
+void Chip8::InvalidateDecodeCache(uint16_t address, unsigned int count)
+{
+    // The instruction starting one byte before address also reads the first written byte
+    for (unsigned int i = 0; i <= count && i < MEMORY_SIZE; ++i)
+        decodeCache[(address - 1u + i) & 0x0FFFu].handler = nullptr;
+
+    // Blocks starting up to MAX_BLOCK_LENGTH instructions before address may cover it
+    unsigned int first = address > 2 * MAX_BLOCK_LENGTH ? address - 2 * MAX_BLOCK_LENGTH : 0u;
+    unsigned int last = address + count < MEMORY_SIZE ? address + count : MEMORY_SIZE;
+
+    if (first < last)
+        memset(&blockLength[first], 0, last - first);
+}
+
+void Chip8::MemoryWritten(uint16_t address, unsigned int count)
+{
+    MarkPagesWritten(address, count);
+    InvalidateDecodeCache(address, count);
+}
+
+void Chip8::MarkPagesWritten(uint16_t address, unsigned int count)
+{
+    ++writeCount;
+
+    // Pages touched by the write (a write running past the end of memory wraps around)
+    unsigned int first = address & 0x0FFFu;
+    unsigned int end = first + (count < MEMORY_SIZE ? count : MEMORY_SIZE);
+
+    for (unsigned int page = first & ~(MEMORY_PAGE_SIZE - 1); page < end; page += MEMORY_PAGE_SIZE)
+        writtenPages |= 1ull << ((page / MEMORY_PAGE_SIZE) % 64u);
+}
+
+void Chip8::MarkRowsDirty(unsigned int first, unsigned int last)
+{
+    ++writeCount;
+
+    // Grow the dirty range to include [first, last]
+    if (!videoDirty)
+    {
+        dirtyRowFirst = first;
+        dirtyRowLast = last;
+        videoDirty = true;
+    }
+    else
+    {
+        if (first < dirtyRowFirst)
+            dirtyRowFirst = first;
+        if (last > dirtyRowLast)
+            dirtyRowLast = last;
+    }
+}
+
+void Chip8::DrawExtendedSprite(bool clip)
+{
+    uint8_t y = (opcode & 0x00F0u) >> 4u; // Register Vy
+    uint8_t x = (opcode & 0x0F00u) >> 8u; // Register Vx
+    uint8_t n = opcode & 0x000Fu;
+
+    unsigned int width = VideoWidth();
+    unsigned int height = VideoHeight();
+    unsigned int rowWords = RowWords();
+
+    // Wrap around if x and y positions exceed screen width and height (both are powers of two)
+    unsigned int xPos = registers[x] & (width - 1);
+    unsigned int yPos = registers[y] & (height - 1);
+
+    // Dxy0 draws a 16x16 sprite (two bytes per row)
+    unsigned int spriteWidth = n ? 8 : 16;
+    unsigned int spriteHeight = n ? n : 16;
+
+    // Clipping drops the rows below the bottom edge, but their bytes still belong to the sprite
+    unsigned int visibleRows = spriteHeight;
+    if (clip && yPos + spriteHeight > height)
+        visibleRows = height - yPos;
+
+    // A sprite row covers at most two words: the one xPos is in and the next one, which is
+    // the first word of the row again when the sprite wraps past the right edge
+    unsigned int word = xPos / 64;
+    unsigned int shift = xPos % 64;
+    unsigned int nextWord = word + 1 < rowWords ? word + 1 : 0;
+    bool spill = shift + spriteWidth > 64 && !(clip && nextWord == 0);
+
+    uint16_t address = index;
+    uint64_t collision = 0;
+
+    // One sprite per selected plane, stored one after the other
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if (!((planes >> plane) & 1u))
+            continue;
+
+        uint64_t* screen = &video[plane * VIDEO_PLANE_WORDS];
+
+        for (unsigned int row = 0; row < visibleRows; ++row)
+        {
+            // Sprite row aligned to column 0 (the most significant bit)
+            uint64_t spriteRow;
+            if (spriteWidth == 16)
+                spriteRow = static_cast<uint64_t>((memory[(address + 2 * row) & 0x0FFFu] << 8u) |
+                                                  memory[(address + 2 * row + 1u) & 0x0FFFu]) << 48u;
+            else
+                spriteRow = static_cast<uint64_t>(memory[(address + row) & 0x0FFFu]) << 56u;
+
+            uint64_t* line = &screen[((yPos + row) & (height - 1)) * rowWords];
+
+            uint64_t first = spriteRow >> shift;
+            collision |= line[word] & first;
+            line[word] ^= first;
+
+            if (spill)
+            {
+                uint64_t second = spriteRow << (64 - shift);
+                collision |= line[nextWord] & second;
+                line[nextWord] ^= second;
+            }
+        }
+
+        address += spriteHeight * (spriteWidth / 8);
+    }
+
+    // Rows touched by the sprite (wrapping past the bottom touches the top rows as well)
+    if (visibleRows > 0 && planes)
+    {
+        if (yPos + visibleRows <= height)
+            MarkRowsDirty(yPos, yPos + visibleRows - 1);
+        else
+            MarkRowsDirty(0, height - 1);
+    }
+
+    // VF = 1 if any pixel was erased (collision occured)
+    registers[0xF] = collision ? 1 : 0;
+}
+
+void Chip8::ScrollDown(unsigned int rows)
+{
+    unsigned int height = VideoHeight();
+    unsigned int rowWords = RowWords();
+
+    if (rows > height)
+        rows = height;
+
+    // Rows are contiguous words, so the whole plane moves with one memmove
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if (!((planes >> plane) & 1u))
+            continue;
+
+        uint64_t* screen = &video[plane * VIDEO_PLANE_WORDS];
+        memmove(screen + rows * rowWords, screen, (height - rows) * rowWords * sizeof(uint64_t));
+        memset(screen, 0, rows * rowWords * sizeof(uint64_t));
+    }
+
+    MarkRowsDirty(0, height - 1);
+}
+
+void Chip8::ScrollUp(unsigned int rows)
+{
+    unsigned int height = VideoHeight();
+    unsigned int rowWords = RowWords();
+
+    if (rows > height)
+        rows = height;
+
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if (!((planes >> plane) & 1u))
+            continue;
+
+        uint64_t* screen = &video[plane * VIDEO_PLANE_WORDS];
+        memmove(screen, screen + rows * rowWords, (height - rows) * rowWords * sizeof(uint64_t));
+        memset(screen + (height - rows) * rowWords, 0, rows * rowWords * sizeof(uint64_t));
+    }
+
+    MarkRowsDirty(0, height - 1);
+}
+
+void Chip8::ScrollRight4()
+{
+    unsigned int height = VideoHeight();
+    unsigned int rowWords = RowWords();
+
+    // Shift every row as a multi-word integer, carrying 4 bits into the next word
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if (!((planes >> plane) & 1u))
+            continue;
+
+        for (unsigned int row = 0; row < height; ++row)
+        {
+            uint64_t* line = &video[plane * VIDEO_PLANE_WORDS + row * rowWords];
+
+            for (unsigned int w = rowWords - 1; w > 0; --w)
+                line[w] = (line[w] >> 4u) | (line[w - 1] << 60u);
+            line[0] >>= 4u;
+        }
+    }
+
+    MarkRowsDirty(0, height - 1);
+}
+
+void Chip8::ScrollLeft4()
+{
+    unsigned int height = VideoHeight();
+    unsigned int rowWords = RowWords();
+
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if (!((planes >> plane) & 1u))
+            continue;
+
+        for (unsigned int row = 0; row < height; ++row)
+        {
+            uint64_t* line = &video[plane * VIDEO_PLANE_WORDS + row * rowWords];
+
+            for (unsigned int w = 0; w + 1 < rowWords; ++w)
+                line[w] = (line[w] << 4u) | (line[w + 1] >> 60u);
+            line[rowWords - 1] <<= 4u;
+        }
+    }
+
+    MarkRowsDirty(0, height - 1);
+}
+
+void Chip8::ClearPlanes(uint8_t mask)
+{
+    // Only the rows of the current mode can be set, the rest of every plane is always clear
+    unsigned int words = VideoHeight() * RowWords();
+
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        if ((mask >> plane) & 1u)
+            memset(&video[plane * VIDEO_PLANE_WORDS], 0, words * sizeof(uint64_t));
+    }
+
+    MarkRowsDirty(0, VideoHeight() - 1);
+}
+
+void Chip8::TickTimers()
+{
+    if (audio)
+        audio->Tick(*this);
 
     // Decrement Delay Timer, if set
     if (delayTimer > 0)
@@ -1,6 +1,7 @@
 #ifndef CHIP8_H
 #define CHIP8_H
 
+#include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <chrono>
@@ -10,60 +11,233 @@
 const unsigned int START_ADDRESS = 0x200;
 const unsigned FONTSET_START_ADDRESS = 0x50;
 
+const unsigned BIG_FONTSET_START_ADDRESS = 0xA0; // SUPER-CHIP/XO-CHIP only
+
 // Other Constants
 const unsigned int FONTSET_SIZE = 80;
+const unsigned int BIG_FONTSET_SIZE = 160;
+const unsigned int TIMER_FREQUENCY = 60; // Delay and Sound timers tick at 60 Hz
+
+// FONTSET Sprites in memory (Each 5 bytes), defined in Chip8.cpp
+extern uint8_t const fontset[FONTSET_SIZE];
+
+// 8x10 FONTSET Sprites of the SUPER-CHIP/XO-CHIP hi-res digits (Each 10 bytes), defined in Chip8.cpp
+extern uint8_t const bigFontset[BIG_FONTSET_SIZE];
+
+// Random number engine of the machines. A fixed engine (instead of std::default_random_engine)
+// gives the same sequence on every standard library and has a single word of state to save.
+typedef std::minstd_rand RandomEngine;
+
+// Seeds the engine of a machine from a run seed. minstd_rand turns the seed 0 into 1, so the
+// seed is offset by one: every seed below RandomEngine::modulus - 1 gives its own sequence.
+inline void SeedRandom(RandomEngine& engine, uint64_t seed)
+{
+    engine.seed(static_cast<RandomEngine::result_type>(seed % (RandomEngine::modulus - 1) + 1));
+}
+
+// Size of the addressable memory (12-bit addresses)
+const unsigned int MEMORY_SIZE = 4096;
+
+// Largest ROM that fits in memory above START_ADDRESS
+const unsigned int MAX_ROM_SIZE = MEMORY_SIZE - START_ADDRESS;
+
+// Granularity of memory write tracking (MEMORY_SIZE / MEMORY_PAGE_SIZE = 64 pages, one bit each)
+const unsigned int MEMORY_PAGE_SIZE = 64;
+
+// Longest run of straight-line instructions translated into one block
+const unsigned int MAX_BLOCK_LENGTH = 32;
+
+// XO-CHIP audio: a 128 bit, 1 bit per sample pattern (F002) played at 4000 * 2^((pitch - 64) / 48)
+// samples per second (Fx3A) while the sound timer is non-zero
+const unsigned int AUDIO_PATTERN_SIZE = 16;
+const uint8_t DEFAULT_PITCH = 64;
+
+class AudioStream;
+
+#ifdef CHIP8_PROFILE
+class Profile;
+#endif
+
+// CHIP-8 interpreters that disagree on how some instructions behave
+enum class QuirkProfile
+{
+    Default,   // This emulator's original behaviour
+    CosmacVip, // The original COSMAC VIP interpreter
+    Chip48,    // CHIP-48 (HP-48 calculators)
+    SuperChip, // SUPER-CHIP 1.1
+    XoChip     // XO-CHIP (Octo)
+};
+
+// What Fx55/Fx65 do to I after the transfer
+enum class IndexQuirk
+{
+    Unchanged,
+    AddX,      // I += x
+    AddXPlus1  // I += x + 1
+};
+
+// Quirk policies. The handlers that differ are templates on one of these, and the
+// constructor puts the instantiation of the selected profile into the function tables,
+// so every profile runs its own specialized handlers without branching on the quirks.
+struct DefaultQuirks
+{
+    static constexpr bool shiftUsesVy = false;   // 8xy6/8xyE: Vx = Vy shifted (instead of Vx shifted)
+    static constexpr bool logicResetsVf = false; // 8xy1/8xy2/8xy3: VF = 0
+    static constexpr bool jumpUsesVx = false;    // Bnnn: jumps to Vx + nnn (x = top nibble of nnn) instead of V0 + nnn
+    static constexpr bool clipSprites = false;   // Dxyn: sprites are clipped at the edges instead of wrapping
+    static constexpr IndexQuirk index = IndexQuirk::Unchanged;
+    static constexpr bool extendedDisplay = false; // SUPER-CHIP hi-res, scrolling, 16x16 sprites and big font
+    static constexpr bool bitPlanes = false;       // XO-CHIP plane selection (Fn01) and scrolling up (00Dn)
+};
+
+struct CosmacVipQuirks
+{
+    static constexpr bool shiftUsesVy = true;
+    static constexpr bool logicResetsVf = true;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool clipSprites = true;
+    static constexpr IndexQuirk index = IndexQuirk::AddXPlus1;
+    static constexpr bool extendedDisplay = false;
+    static constexpr bool bitPlanes = false;
+};
 
-// FONTSET Sprites in memory (Each 5 bytes) (static : For some reason I was getting duplicate symbol in main.o)
-static uint8_t fontset[FONTSET_SIZE] = 
+struct Chip48Quirks
 {
-    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-    0x20, 0x60, 0x20, 0x20, 0x70, // 1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    static constexpr bool shiftUsesVy = false;
+    static constexpr bool logicResetsVf = false;
+    static constexpr bool jumpUsesVx = true;
+    static constexpr bool clipSprites = true;
+    static constexpr IndexQuirk index = IndexQuirk::AddX;
+    static constexpr bool extendedDisplay = false;
+    static constexpr bool bitPlanes = false;
 };
 
-// Video Width and Height
+struct SuperChipQuirks
+{
+    static constexpr bool shiftUsesVy = false;
+    static constexpr bool logicResetsVf = false;
+    static constexpr bool jumpUsesVx = true;
+    static constexpr bool clipSprites = true;
+    static constexpr IndexQuirk index = IndexQuirk::Unchanged;
+    static constexpr bool extendedDisplay = true;
+    static constexpr bool bitPlanes = false;
+};
+
+struct XoChipQuirks
+{
+    static constexpr bool shiftUsesVy = true;
+    static constexpr bool logicResetsVf = false;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool clipSprites = false;
+    static constexpr IndexQuirk index = IndexQuirk::AddXPlus1;
+    static constexpr bool extendedDisplay = true;
+    static constexpr bool bitPlanes = true;
+};
+
+// Command line names of the quirk profiles ("default", "vip", "chip48", "schip", "xochip")
+bool ParseQuirkProfile(char const* name, QuirkProfile& profile);
+char const* QuirkProfileName(QuirkProfile profile);
+
+// Whether opcode is EXIT on the profiles that have it (00FD, table0 decodes the low byte only)
+inline bool IsExit(uint16_t opcode)
+{
+    return (opcode & 0xF0FFu) == 0x00FDu;
+}
+
+// Execution engines
+enum class Engine
+{
+    Interpreter, // One pre-decoded instruction per dispatch
+    Block,       // Whole straight-line blocks of pre-decoded instructions per dispatch
+    Switch       // Independent reference core: fetch and switch-decode every instruction (SwitchCore.cpp)
+};
+
+// Command line names of the engines ("interpreter", "block", "switch")
+bool ParseEngine(char const* name, Engine& engine);
+char const* EngineName(Engine engine);
+
+// Video Width and Height of the lo-res mode (a row of pixels is packed into a single 64-bit word)
 const unsigned int VIDEO_WIDTH = 64;
 const unsigned int VIDEO_HEIGHT = 32;
 
+// Video Width and Height of the SUPER-CHIP/XO-CHIP hi-res mode (a row is two 64-bit words)
+const unsigned int HIRES_VIDEO_WIDTH = 128;
+const unsigned int HIRES_VIDEO_HEIGHT = 64;
+
+// Video memory layout: VIDEO_PLANES bit planes of VIDEO_PLANE_WORDS words each. The rows of
+// the current mode are packed from the start of a plane (1 word per row in lo-res, 2 in hi-res),
+// so a lo-res screen is the first VIDEO_HEIGHT words, like the classic 64x32 framebuffer.
+const unsigned int VIDEO_PLANES = 2; // XO-CHIP draws on up to two planes (4 colors)
+const unsigned int VIDEO_PLANE_WORDS = HIRES_VIDEO_HEIGHT * HIRES_VIDEO_WIDTH / 64;
+const unsigned int VIDEO_WORDS = VIDEO_PLANES * VIDEO_PLANE_WORDS;
+
 class Chip8 
 {
 public:
 
     // Internal components (general note: {} after definition initializes the members with zeroes)
     uint8_t registers[16]{};
-    uint8_t memory[4096]{};
+    uint8_t memory[MEMORY_SIZE]{};
     uint16_t stack[16]{};
     uint16_t index{};
     uint16_t pc{};
     uint8_t sp{};
     uint8_t delayTimer{};
     uint8_t soundTimer{};
-    uint8_t keypad[16]{};
-    uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+    uint16_t keypad{}; // Keys held, bit k = key k (set once per frame by the frontend, see KeypadLatch)
+    uint64_t video[VIDEO_WORDS]{}; // 1 bit per pixel per plane, see VIDEO_PLANE_WORDS, column 0 is the most significant bit
     uint16_t opcode; 
 
+    // Display mode (only changed by the SUPER-CHIP/XO-CHIP opcodes)
+    bool hires{};      // 128x64 (00FF) instead of 64x32 (00FE)
+    uint8_t planes{1}; // Planes drawn, cleared and scrolled (Fn01), bit p = plane p
+
+    // XO-CHIP audio (only changed by F002 and Fx3A)
+    uint8_t audioPattern[AUDIO_PATTERN_SIZE]{};
+    uint8_t pitch{DEFAULT_PITCH};
+
+    // Video change tracking (only OP_00E0, OP_Dxyn and the display mode/scroll opcodes write to video)
+    bool videoDirty{};     // Set when video changed since the last ClearVideoDirty()
+    uint8_t dirtyRowFirst{}; // First changed row (valid when videoDirty)
+    uint8_t dirtyRowLast{};  // Last changed row (valid when videoDirty)
+
+    // Memory write tracking (only OP_Fx33, OP_Fx55, LoadROM and snapshot restores write memory)
+    uint64_t writtenPages{}; // Bit p is set when memory page p was written since the last ClearWrittenPages()
+
+    // Number of memory and video writes so far (MarkPagesWritten, MarkRowsDirty), so a caller can
+    // tell that neither changed between two points without comparing them
+    uint64_t writeCount{};
+
+    // Set when the static analysis (UseStaticAnalysis, Analyzer.hpp) proved that the program never
+    // overwrites its own code: OP_Fx33/OP_Fx55 then neither drop decoded instructions nor end
+    // blocks. Cleared by LoadROM; only restore snapshots of the same program while it is set.
+    bool staticCode{};
+
+#ifdef CHIP8_PROFILE
+    // Hot-path counters (not owned, nullptr = not profiling)
+    Profile* profile{};
+#endif
+
+    // Audio output, fed the sound of every timer period by TickTimers (not owned, nullptr = silent)
+    AudioStream* audio{};
+
     // Members required for Random Number generation
-    std::default_random_engine randGen;
+    RandomEngine randGen;
     std::uniform_int_distribution<uint8_t> randByte;
 
+    // Quirk profile the function tables were set up for
+    QuirkProfile quirks;
+
     // General methods
-    Chip8();
-    void LoadROM(char const* filename);
+    explicit Chip8(QuirkProfile quirks = QuirkProfile::Default);
+
+    // Loads a ROM file, or a ROM image already in memory (e.g. from a RomStore) with a single
+    // bulk copy. Both return false, leaving memory untouched, when the ROM is bigger than MAX_ROM_SIZE.
+    bool LoadROM(char const* filename);
+    bool LoadROM(uint8_t const* data, size_t size);
 
-    // Opcodes
+    // Opcodes (the templates are specialized per quirk policy, see the *Quirks structs;
+    // they are defined and instantiated in Chip8.cpp, reach them through the function tables)
     void OP_NULL(); // NOP instruction
     void OP_00E0(); // CLS
     void OP_00EE(); // RET
@@ -75,19 +249,19 @@ public:
     void OP_6xkk(); // LD Vx, byte
     void OP_7xkk(); // ADD Vx, byte
     void OP_8xy0(); // LD Vx, Vy
-    void OP_8xy1(); // OR Vx, Vy
-    void OP_8xy2(); // AND Vx, Vy
-    void OP_8xy3(); // XOR Vx, Vy
+    template <typename Quirks> void OP_8xy1(); // OR Vx, Vy
+    template <typename Quirks> void OP_8xy2(); // AND Vx, Vy
+    template <typename Quirks> void OP_8xy3(); // XOR Vx, Vy
     void OP_8xy4(); // ADD Vx, Vy
     void OP_8xy5(); // SUB Vx, Vy
-    void OP_8xy6(); // SHR Vx
+    template <typename Quirks> void OP_8xy6(); // SHR Vx
     void OP_8xy7(); // SUBN Vx, Vy
-    void OP_8xyE(); // SHL Vx, {, Vy}
+    template <typename Quirks> void OP_8xyE(); // SHL Vx, {, Vy}
     void OP_9xy0(); // SNE Vx, Vy
     void OP_Annn(); // LD I, addr
-    void OP_Bnnn(); // JP V0, addr
+    template <typename Quirks> void OP_Bnnn(); // JP V0, addr
     void OP_Cxkk(); // RND Vx, byte
-    void OP_Dxyn(); // DRW Vx, Vy, nibble
+    template <typename Quirks> void OP_Dxyn(); // DRW Vx, Vy, nibble
     void OP_Ex9E(); // SKP Vx   
     void OP_ExA1(); // SKNP Vx
     void OP_Fx07(); // LD Vx, DT
@@ -97,23 +271,54 @@ public:
     void OP_Fx1E(); // ADD I, Vx
     void OP_Fx29(); // LD F, Vx
     void OP_Fx33(); // LD B, Vx
-    void OP_Fx55(); // LD [I], Vx
-    void OP_Fx65(); // LD Vx, [I]
+    template <typename Quirks> void OP_Fx55(); // LD [I], Vx
+    template <typename Quirks> void OP_Fx65(); // LD Vx, [I]
+
+    // SUPER-CHIP/XO-CHIP display and XO-CHIP audio opcodes (only in the function tables of the profiles that have them)
+    void OP_00Cn(); // SCD nibble
+    void OP_00Dn(); // SCU nibble (XO-CHIP)
+    void OP_00FB(); // SCR
+    void OP_00FC(); // SCL
+    void OP_00FD(); // EXIT
+    void OP_00FE(); // LOW
+    void OP_00FF(); // HIGH
+    void OP_Fn01(); // PLANE n (XO-CHIP)
+    void OP_F002(); // AUDIO (XO-CHIP)
+    void OP_Fx3A(); // PITCH Vx (XO-CHIP)
+    void OP_Fx30(); // LD HF, Vx
 
     // Function pointer typedef
     typedef void (Chip8::*Chip8Func)(); // This is the syntax for defining pointers to Member functions of a class
 
     // Function tables
     Chip8Func table[0xF + 1]{&Chip8::OP_NULL}; // Master Table (Contains pointers to other table functions)
-    Chip8Func table0[0xE + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0x0
-    Chip8Func table8[0xE + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0x8 
-    Chip8Func tableE[0xE + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0xE
+    Chip8Func table0[0xFF + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0x0 (indexed by the low byte)
+    Chip8Func table8[0xF + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0x8 (indexed by the low nibble)
+    Chip8Func tableE[0xF + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0xE (indexed by the low nibble)
     Chip8Func tableF[0x65 + 1]{&Chip8::OP_NULL}; // Opcodes starting with 0xF
 
+    // Pre-decoded instruction (handler resolved through the function tables + raw opcode)
+    struct DecodedInstruction
+    {
+        Chip8Func handler; // nullptr = not decoded yet
+        uint16_t opcode;
+    };
+
+    // Decode cache, one entry per address the PC can point at. Entries are decoded on
+    // first execution and invalidated when the bytes they were decoded from are written.
+    DecodedInstruction decodeCache[MEMORY_SIZE]{};
+
+    // Number of instructions in the block starting at each address (0 = not built yet).
+    // A block ends at the first jump, call, return, skip, key wait or memory write (unless staticCode).
+    uint8_t blockLength[MEMORY_SIZE]{};
+
+    // Points the function tables at the handlers specialized for Quirks
+    template <typename Quirks> void InstallQuirkHandlers();
+
     // Table helper functions
     void Table0()
     {
-        ((*this).*(table0[opcode & 0x000Fu]))();
+        ((*this).*(table0[opcode & 0x00FFu]))();
     }
 
     void Table8()
@@ -131,9 +336,100 @@ public:
         ((*this).*(tableF[opcode & 0x00FFu]))();
     }
 
-    // Cycle function
+    // Cycle function (fetch, decode and execute a single instruction)
     void Cycle();
 
+    // Engine::Switch: fetches, decodes and executes a single instruction without the function
+    // tables or the decode cache (specialized per quirk policy, defined in SwitchCore.cpp)
+    template <typename Quirks> void SwitchCycle();
+    Chip8Func switchCycle{}; // SwitchCycle of the quirk profile
+
+    // Executes the block starting at the PC, but no more than maxCycles (> 0) instructions.
+    // Returns the number of instructions executed.
+    unsigned int RunBlock(unsigned int maxCycles);
+
+    // Executes the next instruction (Interpreter, Switch) or block (Block), but no more than
+    // maxCycles (> 0) instructions. Returns the number of instructions executed.
+    unsigned int Step(Engine engine, unsigned int maxCycles)
+    {
+        if (engine == Engine::Block)
+            return RunBlock(maxCycles);
+
+        if (engine == Engine::Switch)
+            ((*this).*switchCycle)();
+        else
+            Cycle();
+        return 1;
+    }
+
+    // Translates the straight-line run of instructions starting at address into a block
+    unsigned int BuildBlock(uint16_t address);
+
+    // Resolves the handler of the instruction at address into the decode cache
+    void Decode(uint16_t address);
+
+    // Drops cached decodes and blocks overlapping memory[address, address + count)
+    void InvalidateDecodeCache(uint16_t address, unsigned int count);
+
+    // Records a write to memory[address, address + count): marks the pages written and
+    // invalidates the decode cache. Must be called after writing memory from outside the opcodes.
+    void MemoryWritten(uint16_t address, unsigned int count);
+
+    // Records a store of an opcode: like MemoryWritten, but keeps the decode cache when staticCode is set
+    void StoreWritten(uint16_t address, unsigned int count)
+    {
+        if (staticCode)
+            MarkPagesWritten(address, count);
+        else
+            MemoryWritten(address, count);
+    }
+
+    void MarkPagesWritten(uint16_t address, unsigned int count);
+    void ClearWrittenPages() { writtenPages = 0; }
+
+    // Whether key (masked to 0-F) is held
+    bool KeyDown(unsigned int key) const { return (keypad >> (key & 0xFu)) & 1u; }
+
+    // Decrement the delay and sound timers, must be called at 60 Hz. Feeds audio (when set) the
+    // sound of the period that ends, before the sound timer is decremented.
+    void TickTimers();
+
+    // Video change tracking helpers
+    void MarkRowsDirty(unsigned int first, unsigned int last);
+    void ClearVideoDirty() { videoDirty = false; }
+
+    // Size of the screen in the current display mode
+    unsigned int VideoWidth() const { return hires ? HIRES_VIDEO_WIDTH : VIDEO_WIDTH; }
+    unsigned int VideoHeight() const { return hires ? HIRES_VIDEO_HEIGHT : VIDEO_HEIGHT; }
+    unsigned int RowWords() const { return hires ? HIRES_VIDEO_WIDTH / 64 : VIDEO_WIDTH / 64; }
+
+    // Whether the profile has the SUPER-CHIP display opcodes (hi-res, scrolling, EXIT)
+    bool HasExtendedDisplay() const { return quirks == QuirkProfile::SuperChip || quirks == QuirkProfile::XoChip; }
+
+    // State of the pixel at (x, y) of a plane in the current display mode
+    bool GetPixel(unsigned int x, unsigned int y, unsigned int plane = 0) const
+    {
+        return (video[plane * VIDEO_PLANE_WORDS + y * RowWords() + x / 64] >> (63 - x % 64)) & 1u;
+    }
+
+    // Color (bit p = plane p) of the pixel at (x, y) in the current display mode
+    unsigned int GetColor(unsigned int x, unsigned int y) const
+    {
+        return GetPixel(x, y, 0) | (GetPixel(x, y, 1) << 1);
+    }
+
+    // Extended Dxyn: 8xn or 16x16 (n = 0) sprites, hi-res rows and one sprite per selected plane
+    void DrawExtendedSprite(bool clip);
+
+    // Word-wide scrolling of the selected planes in the current display mode
+    void ScrollDown(unsigned int rows);
+    void ScrollUp(unsigned int rows);
+    void ScrollRight4();
+    void ScrollLeft4();
+
+    // Clears the selected planes (all of them when switching modes)
+    void ClearPlanes(uint8_t mask);
+
 }; 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "Differential.hpp"
+#include "Snapshot.hpp"
+#include <cstring>
+#include <iomanip>
+
+namespace
+{
+    uint16_t OpcodeAt(Chip8 const& chip8, uint16_t address)
+    {
+        return (chip8.memory[address & 0x0FFFu] << 8u) | chip8.memory[(address + 1u) & 0x0FFFu];
+    }
+}
+
+bool SameState(Chip8 const& a, Chip8 const& b)
+{
+    return memcmp(a.registers, b.registers, sizeof(a.registers)) == 0 &&
+           memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 &&
+           a.index == b.index && a.pc == b.pc && a.sp == b.sp &&
+           a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer &&
+           a.hires == b.hires && a.planes == b.planes && a.pitch == b.pitch &&
+           a.randGen == b.randGen &&
+           memcmp(a.audioPattern, b.audioPattern, sizeof(a.audioPattern)) == 0 &&
+           memcmp(a.video, b.video, sizeof(a.video)) == 0 &&
+           memcmp(a.memory, b.memory, sizeof(a.memory)) == 0;
+}
+
+void DescribeDifferences(Chip8 const& a, Chip8 const& b, std::ostream& out)
+{
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill('0');
+    out << std::hex << std::uppercase;
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        if (a.registers[i] != b.registers[i])
+            out << 'V' << i << ": " << std::setw(2) << unsigned(a.registers[i]) << " vs " << std::setw(2) << unsigned(b.registers[i]) << '\n';
+    }
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        if (a.stack[i] != b.stack[i])
+            out << "Stack[" << i << "]: " << std::setw(3) << a.stack[i] << " vs " << std::setw(3) << b.stack[i] << '\n';
+    }
+
+    if (a.index != b.index)
+        out << "I: " << std::setw(3) << a.index << " vs " << std::setw(3) << b.index << '\n';
+    if (a.pc != b.pc)
+        out << "PC: " << std::setw(3) << a.pc << " vs " << std::setw(3) << b.pc << '\n';
+    if (a.sp != b.sp)
+        out << "SP: " << unsigned(a.sp) << " vs " << unsigned(b.sp) << '\n';
+    if (a.delayTimer != b.delayTimer)
+        out << "DT: " << std::setw(2) << unsigned(a.delayTimer) << " vs " << std::setw(2) << unsigned(b.delayTimer) << '\n';
+    if (a.soundTimer != b.soundTimer)
+        out << "ST: " << std::setw(2) << unsigned(a.soundTimer) << " vs " << std::setw(2) << unsigned(b.soundTimer) << '\n';
+    if (a.hires != b.hires)
+        out << "Hi-res: " << a.hires << " vs " << b.hires << '\n';
+    if (a.planes != b.planes)
+        out << "Planes: " << unsigned(a.planes) << " vs " << unsigned(b.planes) << '\n';
+    if (a.pitch != b.pitch)
+        out << "Pitch: " << std::setw(2) << unsigned(a.pitch) << " vs " << std::setw(2) << unsigned(b.pitch) << '\n';
+    if (a.randGen != b.randGen)
+        out << "Random: " << std::setw(8) << RandomState(a.randGen) << " vs " << std::setw(8) << RandomState(b.randGen) << '\n';
+
+    for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; ++i)
+    {
+        if (a.audioPattern[i] != b.audioPattern[i])
+            out << "Pattern[" << i << "]: " << std::setw(2) << unsigned(a.audioPattern[i]) << " vs " << std::setw(2) << unsigned(b.audioPattern[i]) << '\n';
+    }
+
+    for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (a.memory[address] != b.memory[address])
+            out << "Memory[" << std::setw(3) << address << "]: " << std::setw(2) << unsigned(a.memory[address])
+                << " vs " << std::setw(2) << unsigned(b.memory[address]) << '\n';
+    }
+
+    for (unsigned int word = 0; word < VIDEO_WORDS; ++word)
+    {
+        if (a.video[word] != b.video[word])
+            out << "Video[" << std::dec << word / VIDEO_PLANE_WORDS << ':' << word % VIDEO_PLANE_WORDS << std::hex << "]: "
+                << std::setw(16) << a.video[word] << " vs " << std::setw(16) << b.video[word] << '\n';
+    }
+
+    out.fill(fill);
+    out.flags(flags);
+}
+
+Divergence CompareEngines(Chip8& a, Engine engineA, Chip8& b, Engine engineB,
+                          uint64_t fromCycle, uint64_t toCycle, unsigned int cyclesPerFrame)
+{
+    Divergence divergence;
+
+    uint64_t cycleA = fromCycle;
+    uint64_t cycleB = fromCycle;
+    uint64_t agreed = fromCycle; // Last cycle at which the states were equal
+    uint16_t pc = a.pc;          // Next instruction from there
+    uint16_t opcode = OpcodeAt(a, pc);
+
+    while (agreed < toCycle)
+    {
+        // Step the machine that is behind (a on a tie)
+        bool stepA = cycleA <= cycleB;
+        Chip8& chip8 = stepA ? a : b;
+        uint64_t& cycle = stepA ? cycleA : cycleB;
+
+        // Never run past the end of the frame or the comparison
+        unsigned int budget = cyclesPerFrame - cycle % cyclesPerFrame;
+        if (toCycle - cycle < budget)
+            budget = static_cast<unsigned int>(toCycle - cycle);
+
+        cycle += chip8.Step(stepA ? engineA : engineB, budget);
+
+        // Emulated frame boundary
+        if (cycle % cyclesPerFrame == 0)
+            chip8.TickTimers();
+
+        if (cycleA != cycleB)
+            continue;
+
+        if (!SameState(a, b))
+        {
+            divergence.found = true;
+            divergence.cycle = agreed;
+            divergence.instructions = static_cast<unsigned int>(cycleA - agreed);
+            divergence.pc = pc;
+            divergence.opcode = opcode;
+            return divergence;
+        }
+
+        agreed = cycleA;
+        pc = a.pc;
+        opcode = OpcodeAt(a, pc);
+    }
+
+    return divergence;
+}
@@ -0,0 +1,35 @@
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include "Chip8.hpp"
+#include <cstdint>
+#include <ostream>
+
+// Where two engines first disagreed
+struct Divergence
+{
+    bool found{};                // false when the engines agreed all the way
+    uint64_t cycle{};            // Instructions executed at the last point the machines agreed
+    unsigned int instructions{}; // Instructions from there to the first point they disagreed
+    uint16_t pc{};               // Address and opcode of the first of those instructions
+    uint16_t opcode{};
+};
+
+// Whether two machines are in the same state: everything a program can observe (registers,
+// stack, timers, display mode, random number engine, memory and video), not the caches or
+// the change tracking
+bool SameState(Chip8 const& a, Chip8 const& b);
+
+// Writes one line per field that differs between a and b
+void DescribeDifferences(Chip8 const& a, Chip8 const& b, std::ostream& out);
+
+// Runs a with engineA and b with engineB side by side from fromCycle to toCycle, in frames of
+// cyclesPerFrame instructions counted from cycle 0 (like RunHeadless, without halt detection).
+// Both machines must be in the same state at fromCycle. The state is compared whenever both
+// executed the same number of instructions: after every instruction for single-instruction
+// engines, at the block boundaries that the two engines have in common otherwise.
+// Stops at the first comparison that fails, leaving both machines there.
+Divergence CompareEngines(Chip8& a, Engine engineA, Chip8& b, Engine engineB,
+                          uint64_t fromCycle, uint64_t toCycle, unsigned int cyclesPerFrame);
+
+#endif
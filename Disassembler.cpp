@@ -0,0 +1,107 @@
+#include "Disassembler.hpp"
+#include <cstdio>
+
+std::string Disassemble(uint16_t opcode, QuirkProfile quirks)
+{
+    bool extended = quirks == QuirkProfile::SuperChip || quirks == QuirkProfile::XoChip;
+    bool bitPlanes = quirks == QuirkProfile::XoChip;
+
+    unsigned int x = (opcode >> 8u) & 0xFu;
+    unsigned int y = (opcode >> 4u) & 0xFu;
+    unsigned int n = opcode & 0xFu;
+    unsigned int kk = opcode & 0xFFu;
+    unsigned int nnn = opcode & 0x0FFFu;
+
+    char text[32];
+    snprintf(text, sizeof(text), "DW 0x%04X", opcode);
+
+    switch (opcode >> 12u)
+    {
+        case 0x0:
+            // Decoded by the low byte, like the function tables
+            if (extended && (kk & 0xF0u) == 0xC0u)
+                snprintf(text, sizeof(text), "SCD %u", n);
+            else if (bitPlanes && (kk & 0xF0u) == 0xD0u)
+                snprintf(text, sizeof(text), "SCU %u", n);
+            else if (extended && kk == 0xFB)
+                snprintf(text, sizeof(text), "SCR");
+            else if (extended && kk == 0xFC)
+                snprintf(text, sizeof(text), "SCL");
+            else if (extended && kk == 0xFD)
+                snprintf(text, sizeof(text), "EXIT");
+            else if (extended && kk == 0xFE)
+                snprintf(text, sizeof(text), "LOW");
+            else if (extended && kk == 0xFF)
+                snprintf(text, sizeof(text), "HIGH");
+            else if (n == 0x0)
+                snprintf(text, sizeof(text), "CLS");
+            else if (n == 0xE)
+                snprintf(text, sizeof(text), "RET");
+            break;
+
+        case 0x1: snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+        case 0x2: snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+        case 0x3: snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+        case 0x4: snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+        case 0x5: snprintf(text, sizeof(text), "SE V%X, V%X", x, y); break;
+        case 0x6: snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+        case 0x7: snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+
+        case 0x8:
+            switch (n)
+            {
+                case 0x0: snprintf(text, sizeof(text), "LD V%X, V%X", x, y); break;
+                case 0x1: snprintf(text, sizeof(text), "OR V%X, V%X", x, y); break;
+                case 0x2: snprintf(text, sizeof(text), "AND V%X, V%X", x, y); break;
+                case 0x3: snprintf(text, sizeof(text), "XOR V%X, V%X", x, y); break;
+                case 0x4: snprintf(text, sizeof(text), "ADD V%X, V%X", x, y); break;
+                case 0x5: snprintf(text, sizeof(text), "SUB V%X, V%X", x, y); break;
+                case 0x6: snprintf(text, sizeof(text), "SHR V%X, V%X", x, y); break;
+                case 0x7: snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y); break;
+                case 0xE: snprintf(text, sizeof(text), "SHL V%X, V%X", x, y); break;
+            }
+            break;
+
+        case 0x9: snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case 0xA: snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+
+        case 0xB:
+            if (quirks == QuirkProfile::Chip48 || quirks == QuirkProfile::SuperChip)
+                snprintf(text, sizeof(text), "JP V%X, 0x%03X", x, nnn);
+            else
+                snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn);
+            break;
+
+        case 0xC: snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+        case 0xD: snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+
+        case 0xE:
+            // Decoded by the low nibble
+            if (n == 0xE)
+                snprintf(text, sizeof(text), "SKP V%X", x);
+            else if (n == 0x1)
+                snprintf(text, sizeof(text), "SKNP V%X", x);
+            break;
+
+        case 0xF:
+            switch (kk)
+            {
+                case 0x01: if (bitPlanes) snprintf(text, sizeof(text), "PLANE %u", x); break;
+                case 0x02: if (bitPlanes) snprintf(text, sizeof(text), "AUDIO"); break;
+                case 0x07: snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+                case 0x0A: snprintf(text, sizeof(text), "LD V%X, K", x); break;
+                case 0x15: snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+                case 0x18: snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+                case 0x1E: snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+                case 0x29: snprintf(text, sizeof(text), "LD F, V%X", x); break;
+                case 0x30: if (extended) snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+                case 0x3A: if (bitPlanes) snprintf(text, sizeof(text), "PITCH V%X", x); break;
+                case 0x33: snprintf(text, sizeof(text), "LD B, V%X", x); break;
+                case 0x55: snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+                case 0x65: snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+            }
+            break;
+    }
+
+    return text;
+}
@@ -0,0 +1,13 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include "Chip8.hpp"
+#include <cstdint>
+#include <string>
+
+// Mnemonic of an instruction as the given profile decodes it (Cowgod's syntax, e.g.
+// "DRW V1, V2, 5"; the SUPER-CHIP and XO-CHIP opcodes only on the profiles that have them).
+// Opcodes the profile does not know disassemble as "DW 0x1234".
+std::string Disassemble(uint16_t opcode, QuirkProfile quirks = QuirkProfile::Default);
+
+#endif
@@ -0,0 +1,27 @@
+#include "FrameBuffer.hpp"
+#include <cstring>
+
+void FrameTripleBuffer::Publish(Chip8& chip8)
+{
+    VideoFrame& frame = slots[back];
+
+    memcpy(frame.video, chip8.video, sizeof(frame.video));
+    frame.hires = chip8.hires;
+    frame.twoPlanes = chip8.quirks == QuirkProfile::XoChip;
+    frame.dirtyRowFirst = chip8.videoDirty ? chip8.dirtyRowFirst : 0;
+    frame.dirtyRowLast = chip8.videoDirty ? chip8.dirtyRowLast : 0;
+    frame.sequence = ++sequence;
+    chip8.ClearVideoDirty();
+
+    // Hand the frame over and take the slot the reader is done with (or the unread older frame)
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+VideoFrame const* FrameTripleBuffer::Latest()
+{
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        return nullptr;
+
+    front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+    return &slots[front];
+}
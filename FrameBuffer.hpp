@@ -0,0 +1,48 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include "Chip8.hpp"
+#include <atomic>
+#include <cstdint>
+
+// A completed frame of video as published by the emulation thread
+struct VideoFrame
+{
+    uint64_t video[VIDEO_WORDS]{};
+    bool hires{};
+    bool twoPlanes{};         // Plane 1 is shown too (XO-CHIP)
+    uint8_t dirtyRowFirst{};  // Rows changed since the previously published frame
+    uint8_t dirtyRowLast{};
+    uint64_t sequence{};      // 1 for the first published frame, then +1 per frame
+
+    unsigned int Width() const { return hires ? HIRES_VIDEO_WIDTH : VIDEO_WIDTH; }
+    unsigned int Height() const { return hires ? HIRES_VIDEO_HEIGHT : VIDEO_HEIGHT; }
+};
+
+// Lock-free triple buffer of video frames between one writer (the emulation thread) and one
+// reader (the render thread). Each side owns a slot and they swap through the third one, so the
+// writer never waits for a slow presenter and the reader always gets the latest completed frame,
+// never one being written. Frames the reader had no time for are dropped.
+class FrameTripleBuffer
+{
+public:
+    // Writer: copies the video of chip8 and its dirty rows into a frame, publishes it and
+    // clears chip8's video dirty flag
+    void Publish(Chip8& chip8);
+
+    // Reader: the latest published frame, or nullptr when none was published since the last
+    // call. The frame stays valid until the next call. A frame whose sequence does not follow
+    // the previous one has changes in more rows than its dirty rows.
+    VideoFrame const* Latest();
+
+private:
+    static const unsigned int FRESH = 4u; // Set in middle while it holds a frame the reader has not taken
+
+    VideoFrame slots[3];
+    std::atomic<unsigned int> middle{1}; // Slot being exchanged (| FRESH)
+    unsigned int back{0};                // Slot the writer fills
+    unsigned int front{2};               // Slot the reader shows
+    uint64_t sequence{};                 // Frames published (writer)
+};
+
+#endif
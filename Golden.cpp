@@ -0,0 +1,177 @@
+#include "Golden.hpp"
+#include "Analyzer.hpp"
+#include "Headless.hpp"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace
+{
+    // Splits "key=value", returns false when the token is not for key
+    bool Field(std::string const& token, char const* key, std::string& value)
+    {
+        size_t length = strlen(key);
+        if (token.size() <= length || token.compare(0, length, key) != 0 || token[length] != '=')
+            return false;
+
+        value = token.substr(length + 1);
+        return true;
+    }
+
+    bool ParseNumber(std::string const& text, uint64_t& value, int base = 10)
+    {
+        if (text.empty())
+            return false;
+
+        char* end = nullptr;
+        value = std::strtoull(text.c_str(), &end, base);
+        return *end == '\0';
+    }
+}
+
+bool WriteGoldenFile(char const* filename, GoldenSettings const& settings, std::vector<GoldenRecord> const& records)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    file << "chip8-golden " << GOLDEN_VERSION
+         << " cycles=" << settings.cycles
+         << " ipf=" << settings.cyclesPerFrame
+         << " quirks=" << QuirkProfileName(settings.quirks)
+         << " checkpoint=" << settings.checkpointFrames
+         << " state=" << (settings.fullState ? "full" : "video") << '\n';
+
+    for (GoldenRecord const& record : records)
+    {
+        file << "seed=" << record.seed
+             << " cycles=" << record.cycles
+             << " halt=" << record.halt
+             << " checkpoints=" << std::hex;
+
+        for (size_t i = 0; i < record.checkpoints.size(); ++i)
+            file << (i ? "," : "") << record.checkpoints[i];
+
+        file << std::dec << " rom=" << record.romName << '\n';
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool ReadGoldenFile(char const* filename, GoldenSettings& settings, std::vector<GoldenRecord>& records)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    if (!std::getline(file, line))
+        return false;
+
+    // Header
+    GoldenSettings header;
+    {
+        std::istringstream tokens(line);
+        std::string magic, token, value;
+        unsigned int version = 0;
+        if (!(tokens >> magic >> version) || magic != "chip8-golden" || version != GOLDEN_VERSION)
+            return false;
+
+        while (tokens >> token)
+        {
+            uint64_t number = 0;
+            if (Field(token, "cycles", value) && ParseNumber(value, number))
+                header.cycles = number;
+            else if (Field(token, "ipf", value) && ParseNumber(value, number) && number > 0 && number <= 0xFFFFFFFFu)
+                header.cyclesPerFrame = static_cast<unsigned int>(number);
+            else if (Field(token, "quirks", value) && ParseQuirkProfile(value.c_str(), header.quirks))
+                continue;
+            else if (Field(token, "checkpoint", value) && ParseNumber(value, number) && number > 0 && number <= 0xFFFFFFFFu)
+                header.checkpointFrames = static_cast<unsigned int>(number);
+            else if (Field(token, "state", value) && (value == "video" || value == "full"))
+                header.fullState = value == "full";
+            else
+                return false;
+        }
+    }
+
+    // One record per line, the ROM name takes the rest of the line
+    std::vector<GoldenRecord> read;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        size_t rom = line.find(" rom=");
+        if (rom == std::string::npos)
+            return false;
+
+        GoldenRecord record;
+        record.romName = line.substr(rom + 5);
+
+        std::istringstream tokens(line.substr(0, rom));
+        std::string token, value;
+        while (tokens >> token)
+        {
+            if (Field(token, "seed", value) && ParseNumber(value, record.seed))
+                continue;
+            else if (Field(token, "cycles", value) && ParseNumber(value, record.cycles))
+                continue;
+            else if (Field(token, "halt", value))
+                record.halt = value;
+            else if (Field(token, "checkpoints", value))
+            {
+                std::istringstream hashes(value);
+                std::string hash;
+                while (std::getline(hashes, hash, ','))
+                {
+                    uint64_t number = 0;
+                    if (!ParseNumber(hash, number, 16))
+                        return false;
+                    record.checkpoints.push_back(number);
+                }
+            }
+            else
+                return false;
+        }
+
+        read.push_back(record);
+    }
+
+    settings = header;
+    records = std::move(read);
+    return true;
+}
+
+Divergence FindDivergence(RomImage const& rom, uint64_t seed, GoldenSettings const& settings,
+                          Engine engine, uint64_t fromCycle, uint64_t toCycle, bool staticAnalysis)
+{
+    Divergence divergence;
+
+    // Same settings as the batch run (RunBatch)
+    QuirkProfile quirks = rom.hasQuirks ? rom.quirks : settings.quirks;
+    unsigned int cyclesPerFrame = rom.cyclesPerFrame ? rom.cyclesPerFrame : settings.cyclesPerFrame;
+
+    std::unique_ptr<Chip8> reference(new Chip8(quirks));
+    std::unique_ptr<Chip8> chip8(new Chip8(quirks));
+    SeedRandom(reference->randGen, seed);
+    SeedRandom(chip8->randGen, seed);
+
+    if (!reference->LoadROM(rom.data, rom.size) || !chip8->LoadROM(rom.data, rom.size))
+        return divergence;
+
+    if (staticAnalysis)
+        UseStaticAnalysis(*chip8);
+
+    uint64_t cycle = RunHeadless(*reference, fromCycle, cyclesPerFrame, Engine::Interpreter).cycles;
+    if (RunHeadless(*chip8, fromCycle, cyclesPerFrame, engine).cycles != cycle)
+    {
+        // Halted at different points on the way
+        divergence.found = true;
+        divergence.cycle = cycle;
+        return divergence;
+    }
+
+    return CompareEngines(*chip8, engine, *reference, Engine::Interpreter, cycle, toCycle, cyclesPerFrame);
+}
@@ -0,0 +1,57 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "Chip8.hpp"
+#include "Differential.hpp"
+#include "RomStore.hpp"
+#include "Scheduler.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Golden files: the checkpoint hashes of a batch of reference runs, as text so they can be
+// kept next to the ROMs and diffed. One header line with the settings of the runs, then one
+// line per machine:
+//
+//   chip8-golden 2 cycles=<N> ipf=<N> quirks=<profile> checkpoint=<frames> state=video|full
+//   seed=<N> cycles=<N> halt=<reason> checkpoints=<hex>,<hex>,... rom=<name>
+//
+// A checkpoint is taken every <checkpoint> frames and when the run ends; it hashes the video
+// (HashVideo) or the whole machine (HashState). ROMs that carry their own quirk profile or
+// speed (see RomImage) run with those, like in any batch. Machines are seeded with SeedRandom
+// (version 1 files were written with seeds 0 and 1 giving the same random sequence).
+const unsigned int GOLDEN_VERSION = 2;
+
+struct GoldenSettings
+{
+    uint64_t cycles{}; // Cycle budget of every machine
+    unsigned int cyclesPerFrame{DEFAULT_CYCLES_PER_FRAME};
+    QuirkProfile quirks{QuirkProfile::Default};
+    unsigned int checkpointFrames{60};
+    bool fullState{}; // Checkpoints hash the whole state instead of only the video
+};
+
+// The reference run of one machine
+struct GoldenRecord
+{
+    std::string romName;
+    uint64_t seed{};
+    uint64_t cycles{};    // Instructions executed before the run ended
+    std::string halt;     // HaltReasonName of the end of the run
+    std::vector<uint64_t> checkpoints;
+};
+
+bool WriteGoldenFile(char const* filename, GoldenSettings const& settings, std::vector<GoldenRecord> const& records);
+
+// Returns false when the file cannot be read or is not a golden file of this version
+bool ReadGoldenFile(char const* filename, GoldenSettings& settings, std::vector<GoldenRecord>& records);
+
+// Runs rom under engine and under the reference interpreter (Chip8::Cycle) side by side and
+// compares the complete machine state after every step in [fromCycle, toCycle) (see
+// CompareEngines). fromCycle must be on a frame boundary; both machines fast-forward to it
+// without comparing. With staticAnalysis the engine's machine uses UseStaticAnalysis, like a
+// batch run with RunnerOptions::staticAnalysis, and the reference does not.
+Divergence FindDivergence(RomImage const& rom, uint64_t seed, GoldenSettings const& settings,
+                          Engine engine, uint64_t fromCycle, uint64_t toCycle, bool staticAnalysis = false);
+
+#endif
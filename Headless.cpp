@@ -0,0 +1,117 @@
+#include "Headless.hpp"
+#include "Idle.hpp"
+#include "Profile.hpp"
+#include <chrono>
+#include <iomanip>
+
+HeadlessResult RunHeadless(Chip8& chip8, uint64_t maxCycles, unsigned int cyclesPerFrame, Engine engine, bool skipIdle)
+{
+    HeadlessResult result;
+    unsigned int frameCycles = 0; // Instructions executed in the current frame
+    IdleDetector idle;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    while (result.cycles < maxCycles)
+    {
+        // The fetch reads two bytes, so the PC must leave room for both
+        if (chip8.pc > sizeof(chip8.memory) - 2)
+        {
+            result.reason = HaltReason::PcOutOfRange;
+            break;
+        }
+
+        // A jump to the current instruction can never make progress again
+        uint16_t nextOpcode = (chip8.memory[chip8.pc] << 8u) | chip8.memory[chip8.pc + 1];
+        if (nextOpcode == (0x1000u | chip8.pc))
+        {
+            result.reason = HaltReason::SelfJump;
+            break;
+        }
+
+        // EXIT never moves on either
+        if (IsExit(nextOpcode) && chip8.HasExtendedDisplay())
+        {
+            result.reason = HaltReason::Exit;
+            break;
+        }
+
+        // Never run past the end of the frame or the cycle limit
+        unsigned int budget = cyclesPerFrame - frameCycles;
+        if (maxCycles - result.cycles < budget)
+            budget = static_cast<unsigned int>(maxCycles - result.cycles);
+
+        uint16_t pc = chip8.pc;
+        unsigned int executed = chip8.Step(engine, budget);
+        if (skipIdle)
+            executed += idle.Skip(chip8, pc, executed, budget - executed);
+
+        result.cycles += executed;
+        frameCycles += executed;
+
+        // Emulated frame boundary
+        if (frameCycles == cyclesPerFrame)
+        {
+            idle.BeforeTick(chip8);
+            chip8.TickTimers();
+            CHIP8_PROFILE_END_FRAME(chip8.profile);
+            frameCycles = 0;
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+    result.idleCycles = idle.Skipped();
+
+    return result;
+}
+
+char const* HaltReasonName(HaltReason reason)
+{
+    switch (reason)
+    {
+        case HaltReason::CycleLimit: return "cycle-limit";
+        case HaltReason::SelfJump: return "self-jump";
+        case HaltReason::Exit: return "exit";
+        case HaltReason::PcOutOfRange: return "pc-out-of-range";
+    }
+
+    return "unknown";
+}
+
+void DumpState(Chip8 const& chip8, std::ostream& out)
+{
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill('0');
+
+    // General purpose registers
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        out << 'V' << std::hex << std::uppercase << i << '=' << std::setw(2) << unsigned(chip8.registers[i])
+            << (i % 8 == 7 ? '\n' : ' ');
+    }
+
+    // Special registers and timers
+    out << "I=" << std::setw(3) << chip8.index
+        << " PC=" << std::setw(3) << chip8.pc
+        << " SP=" << unsigned(chip8.sp)
+        << " DT=" << std::setw(2) << unsigned(chip8.delayTimer)
+        << " ST=" << std::setw(2) << unsigned(chip8.soundTimer) << '\n';
+
+    // Return addresses currently on the stack
+    out << "Stack:";
+    for (unsigned int i = 0; i < chip8.sp && i < 16; ++i)
+        out << ' ' << std::setw(3) << chip8.stack[i];
+    out << '\n';
+
+    // Video memory, one character per pixel ('+' and '@' are XO-CHIP's second plane colors)
+    for (unsigned int y = 0; y < chip8.VideoHeight(); ++y)
+    {
+        for (unsigned int x = 0; x < chip8.VideoWidth(); ++x)
+            out << ".#+@"[chip8.GetColor(x, y)];
+        out << '\n';
+    }
+
+    out.fill(fill);
+    out.flags(flags);
+}
@@ -0,0 +1,43 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "Chip8.hpp"
+#include "Scheduler.hpp"
+#include <cstdint>
+#include <ostream>
+
+// Reasons for a headless run to stop
+enum class HaltReason
+{
+    CycleLimit,  // The requested number of cycles was executed
+    SelfJump,    // A 1nnn instruction jumps to itself (usual "end of program" idiom)
+    Exit,        // SUPER-CHIP EXIT (00FD)
+    PcOutOfRange // The PC left the addressable memory
+};
+
+// Outcome of a headless run
+struct HeadlessResult
+{
+    uint64_t cycles{};                         // Number of instructions executed
+    HaltReason reason{HaltReason::CycleLimit}; // Why the run stopped
+    double seconds{};                          // Host wall-clock time spent executing
+    uint64_t idleCycles{};                     // Instructions of idle loops counted in cycles without running them
+};
+
+// Runs Chip8::Cycle flat-out (no window, no input polling, no throttling)
+// until maxCycles instructions were executed or a halt condition is hit.
+// The timers tick once every cyclesPerFrame instructions, like a 60 Hz frame would.
+// With Engine::Block the halt conditions are checked at block boundaries, which
+// gives the same result since blocks never contain a jump to themselves (or an EXIT).
+// With skipIdle the passes of busy-wait loops are skipped up to the next frame (IdleDetector).
+HeadlessResult RunHeadless(Chip8& chip8, uint64_t maxCycles,
+                           unsigned int cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME,
+                           Engine engine = Engine::Interpreter, bool skipIdle = false);
+
+// Human readable name of a halt reason
+char const* HaltReasonName(HaltReason reason);
+
+// Writes the registers, stack, timers and the video memory as text
+void DumpState(Chip8 const& chip8, std::ostream& out);
+
+#endif
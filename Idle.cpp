@@ -0,0 +1,92 @@
+#include "Idle.hpp"
+#include <cstring>
+
+// Backward transfers to other addresses before the watched loop head is given up
+// (a waiting loop that calls a subroutine returns to a second address every pass)
+const unsigned int MAX_LOOP_MISSES = 8;
+
+// Longest stretch of passes a busy (not idle) loop runs between two comparisons
+const unsigned int MAX_IDLE_BACKOFF = 32;
+
+unsigned int IdleDetector::LoopHead(Chip8 const& chip8, unsigned int remaining)
+{
+    uint16_t pc = chip8.pc;
+
+    if (!watching || pc != loopPc)
+    {
+        if (!watching || ++misses > MAX_LOOP_MISSES)
+        {
+            loopPc = pc;
+            backoff = 0;
+            wait = 0;
+            Record(chip8);
+        }
+        return 0;
+    }
+
+    misses = 0;
+
+    if (wait)
+    {
+        --wait;
+        return 0;
+    }
+
+    if (!Matches(chip8))
+    {
+        // Still busy, look again later (and less often the longer it stays busy)
+        backoff = backoff < MAX_IDLE_BACKOFF ? backoff * 2 + 1 : MAX_IDLE_BACKOFF;
+        wait = backoff;
+        Record(chip8);
+        return 0;
+    }
+
+    // The state repeats every (cycle - loopCycle) instructions from here on
+    uint64_t period = cycle - loopCycle;
+    backoff = 0;
+
+    if (period == 0 || period > remaining)
+        return 0;
+
+    unsigned int skip = remaining - static_cast<unsigned int>(remaining % period);
+    cycle += skip;
+    loopCycle = cycle;
+    skipped += skip;
+    return skip;
+}
+
+void IdleDetector::Reset()
+{
+    watching = false;
+}
+
+void IdleDetector::Record(Chip8 const& chip8)
+{
+    watching = true;
+    misses = 0;
+    loopCycle = cycle;
+
+    memcpy(signature.registers, chip8.registers, sizeof(signature.registers));
+    memcpy(signature.stack, chip8.stack, sizeof(signature.stack));
+    signature.keypad = chip8.keypad;
+    signature.index = chip8.index;
+    signature.sp = chip8.sp;
+    signature.delayTimer = chip8.delayTimer;
+    signature.soundTimer = chip8.soundTimer;
+    signature.hires = chip8.hires;
+    signature.planes = chip8.planes;
+    signature.writeCount = chip8.writeCount;
+    signature.randGen = chip8.randGen;
+}
+
+bool IdleDetector::Matches(Chip8 const& chip8) const
+{
+    return signature.writeCount == chip8.writeCount &&
+           memcmp(signature.registers, chip8.registers, sizeof(signature.registers)) == 0 &&
+           signature.index == chip8.index && signature.sp == chip8.sp &&
+           signature.delayTimer == chip8.delayTimer && signature.soundTimer == chip8.soundTimer &&
+           signature.hires == chip8.hires && signature.planes == chip8.planes &&
+           memcmp(signature.stack, chip8.stack, sizeof(signature.stack)) == 0 &&
+           signature.keypad == chip8.keypad &&
+           signature.randGen == chip8.randGen;
+}
@@ -0,0 +1,80 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "Chip8.hpp"
+#include <cstdint>
+
+// Busy-wait detection. ROMs wait for the delay timer (Fx07, 3xkk, 1nnn loops) or for a key
+// (Fx0A re-executes itself) by spinning. When the PC comes back to the same loop head with
+// the machine in exactly the same state (registers, I, stack, timers, keypad, random number
+// generator, and no memory or video write in between), every further pass of the loop repeats
+// the last one until something outside the CPU changes the state. Those passes are counted as
+// executed without running them, which gives the same machine state at every frame boundary.
+class IdleDetector
+{
+public:
+    // Call after every Chip8::Step. pcBefore is the PC before the step, executed its result and
+    // remaining the instructions left before the next frame boundary or input event. Returns
+    // the instructions to count as executed without running them (whole passes of an idle
+    // loop, at most remaining).
+    unsigned int Skip(Chip8 const& chip8, uint16_t pcBefore, unsigned int executed, unsigned int remaining)
+    {
+        cycle += executed;
+
+        // Straight-line code only moves forward, a loop closes with a jump back (or a key
+        // wait, which stays in place)
+        if (chip8.pc > pcBefore)
+            return 0;
+
+        return LoopHead(chip8, remaining);
+    }
+
+    // Call before Chip8::TickTimers: a tick that changes a timer ends the pass being watched
+    void BeforeTick(Chip8 const& chip8)
+    {
+        if (chip8.delayTimer || chip8.soundTimer)
+            Reset();
+    }
+
+    // Forgets the loop being watched. Call whenever the state is changed from outside the
+    // CPU (keypad changes, snapshot restores).
+    void Reset();
+
+    // Instructions skipped so far
+    uint64_t Skipped() const { return skipped; }
+
+private:
+    // Everything the next instructions depend on, apart from memory and video
+    struct Signature
+    {
+        uint8_t registers[16];
+        uint16_t stack[16];
+        uint16_t keypad;
+        uint16_t index;
+        uint8_t sp;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+        bool hires;
+        uint8_t planes;
+        uint64_t writeCount;
+        RandomEngine randGen;
+    };
+
+    // Skip() at a backward transfer: watches the loop head and skips once it is idle
+    unsigned int LoopHead(Chip8 const& chip8, unsigned int remaining);
+
+    void Record(Chip8 const& chip8);
+    bool Matches(Chip8 const& chip8) const;
+
+    uint64_t cycle{};       // Instructions seen (executed or skipped)
+    bool watching{};        // A loop head is being watched
+    uint16_t loopPc{};      // The loop head: target of a backward jump, return or key wait
+    uint64_t loopCycle{};   // cycle when the signature was taken
+    Signature signature{};  // State at loopPc
+    unsigned int misses{};  // Backward transfers elsewhere since loopPc was last seen
+    unsigned int backoff{}; // Passes to let go by before comparing again (busy loops)
+    unsigned int wait{};
+    uint64_t skipped{};
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "Keymap.hpp"
+#include <fstream>
+
+Keymap DefaultKeymap()
+{
+    static char const* const HOST_KEYS[16] = {
+        "X", "1", "2", "3", "Q", "W", "E", "A", "S", "D", "Z", "C", "4", "R", "F", "V"};
+
+    Keymap keymap;
+    for (unsigned int key = 0; key < 16; ++key)
+    {
+        KeyBinding binding;
+        binding.hostKey = HOST_KEYS[key];
+        binding.key = static_cast<uint8_t>(key);
+        keymap.push_back(binding);
+    }
+    return keymap;
+}
+
+bool ReadKeymapFile(char const* filename, Keymap& keymap)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    Keymap read;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            continue;
+
+        // One hex digit, then the host key name (which may contain spaces) up to the end of the line
+        char digit = line[first];
+        unsigned int key;
+        if (digit >= '0' && digit <= '9')
+            key = digit - '0';
+        else if (digit >= 'A' && digit <= 'F')
+            key = digit - 'A' + 10;
+        else if (digit >= 'a' && digit <= 'f')
+            key = digit - 'a' + 10;
+        else
+            return false;
+
+        size_t name = line.find_first_not_of(" \t", first + 1);
+        if (name == first + 1 || name == std::string::npos)
+            return false;
+
+        KeyBinding binding;
+        binding.hostKey = line.substr(name, line.find_last_not_of(" \t\r") + 1 - name);
+        binding.key = static_cast<uint8_t>(key);
+        read.push_back(binding);
+    }
+
+    keymap = read;
+    return true;
+}
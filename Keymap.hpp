@@ -0,0 +1,63 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Host keys bound to the 16 CHIP-8 keys. A keymap file has one binding per line:
+//
+//   <CHIP-8 key, hex digit> <host key name>
+//
+// e.g. "A Z" or "5 Keypad 5". Host key names are SDL key names ("X", "1", "Up", "Keypad 5",
+// matched without case); '#' starts a comment. A CHIP-8 key may have several host keys.
+struct KeyBinding
+{
+    std::string hostKey;
+    uint8_t key{};
+};
+
+typedef std::vector<KeyBinding> Keymap;
+
+// The usual layout of the 4x4 keypad on the left of a QWERTY keyboard:
+//   1 2 3 C      1 2 3 4
+//   4 5 6 D  ->  Q W E R
+//   7 8 9 E      A S D F
+//   A 0 B F      Z X C V
+Keymap DefaultKeymap();
+
+// Reads a keymap file (replacing keymap). Returns false when it cannot be read or a line is malformed.
+bool ReadKeymapFile(char const* filename, Keymap& keymap);
+
+// Collects key events from any input source (the SDL window, a gamepad, a pipe) between two
+// frames, and gives the machine one keypad state per frame (Chip8::keypad). A key pressed and
+// released again before the frame starts still reads as held for that frame, so short taps
+// are never lost; the release shows up in the next frame. Lock-free: the input thread can
+// Press/Release while the emulation thread latches.
+class KeypadLatch
+{
+public:
+    void Press(unsigned int key)
+    {
+        held.fetch_or(1u << key, std::memory_order_relaxed);
+        pressed.fetch_or(1u << key, std::memory_order_relaxed);
+    }
+
+    void Release(unsigned int key) { held.fetch_and(~(1u << key), std::memory_order_relaxed); }
+
+    // The keypad state for the next frame (bit k = key k), starts collecting the next one
+    uint16_t Latch()
+    {
+        return static_cast<uint16_t>(held.load(std::memory_order_relaxed) | pressed.exchange(0, std::memory_order_relaxed));
+    }
+
+    // Keys held right now
+    uint16_t Held() const { return static_cast<uint16_t>(held.load(std::memory_order_relaxed)); }
+
+private:
+    std::atomic<unsigned int> held{};    // Keys down
+    std::atomic<unsigned int> pressed{}; // Keys that went down since the last Latch()
+};
+
+#endif
@@ -0,0 +1,521 @@
+#include "Lockstep.hpp"
+#include <algorithm>
+#include <cstring>
+
+LockstepBatch::LockstepBatch(unsigned int lanes)
+    : lanes(lanes),
+      registers(16 * lanes), stack(16 * lanes), keypad(16 * lanes),
+      index(lanes), pc(lanes, START_ADDRESS), sp(lanes), delayTimer(lanes), soundTimer(lanes),
+      randGen(lanes), stepKeys(lanes), stepOrder(lanes),
+      memory(MEMORY_SIZE * lanes), video(VIDEO_HEIGHT * lanes),
+      randByte(0, 255U)
+{
+    // Load Fonts into the memory of every lane
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+        memcpy(&memory[lane * MEMORY_SIZE + FONTSET_START_ADDRESS], fontset, FONTSET_SIZE);
+}
+
+bool LockstepBatch::LoadROM(char const* filename)
+{
+    // Let a single machine do the loading and replicate its program memory
+    Chip8 loader;
+    if (!loader.LoadROM(filename))
+        return false;
+
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+        memcpy(&memory[lane * MEMORY_SIZE + START_ADDRESS], &loader.memory[START_ADDRESS], MEMORY_SIZE - START_ADDRESS);
+
+    return true;
+}
+
+bool LockstepBatch::LoadROM(uint8_t const* data, size_t size)
+{
+    if (size > MAX_ROM_SIZE)
+        return false;
+
+    // Program memory is everything above START_ADDRESS, like a loaded file
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+    {
+        uint8_t* program = &memory[lane * MEMORY_SIZE + START_ADDRESS];
+
+        if (size > 0)
+            memcpy(program, data, size);
+        memset(program + size, 0, MAX_ROM_SIZE - size);
+    }
+
+    return true;
+}
+
+void LockstepBatch::Seed(unsigned int lane, uint64_t seed)
+{
+    SeedRandom(randGen[lane], seed);
+}
+
+void LockstepBatch::Run(uint64_t cycles, unsigned int cyclesPerFrame)
+{
+    unsigned int frameCycles = 0;
+
+    for (uint64_t i = 0; i < cycles; ++i)
+    {
+        Step();
+
+        // Emulated frame boundary
+        if (++frameCycles == cyclesPerFrame)
+        {
+            TickTimers();
+            frameCycles = 0;
+        }
+    }
+}
+
+void LockstepBatch::Step()
+{
+    // The lanes can run together when they all fetch the same opcode at the same PC
+    uint16_t leaderPc = pc[0];
+    uint16_t leaderOpcode = Fetch(0);
+
+    bool converged = true;
+    for (unsigned int lane = 1; lane < lanes && converged; ++lane)
+        converged = pc[lane] == leaderPc && Fetch(lane) == leaderOpcode;
+
+    if (converged)
+    {
+        ++convergedSteps;
+        Execute(leaderOpcode, LaneRange{0, lanes});
+        return;
+    }
+
+    ++divergedSteps;
+
+    // Group the lanes by PC and opcode. Every key is taken before anything executes, and a
+    // group only touches its own lanes, so the groups can run one after the other.
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+    {
+        stepKeys[lane] = (static_cast<uint32_t>(pc[lane]) << 16u) | Fetch(lane);
+        stepOrder[lane] = lane;
+    }
+
+    std::sort(stepOrder.begin(), stepOrder.end(), [this](unsigned int a, unsigned int b) {
+        return stepKeys[a] < stepKeys[b] || (stepKeys[a] == stepKeys[b] && a < b);
+    });
+
+    for (unsigned int first = 0; first < lanes;)
+    {
+        uint32_t key = stepKeys[stepOrder[first]];
+        unsigned int last = first + 1;
+        while (last < lanes && stepKeys[stepOrder[last]] == key)
+            ++last;
+
+        uint16_t opcode = key & 0xFFFFu;
+        unsigned int count = last - first;
+
+        if (count >= 2)
+        {
+            groupedLanes += count;
+            Execute(opcode, LaneList{&stepOrder[first], count});
+        }
+        else
+        {
+            ++singleLanes;
+            Execute(opcode, LaneRange{stepOrder[first], 1});
+        }
+
+        first = last;
+    }
+}
+
+void LockstepBatch::TickTimers()
+{
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+    {
+        delayTimer[lane] -= delayTimer[lane] > 0;
+        soundTimer[lane] -= soundTimer[lane] > 0;
+    }
+}
+
+void LockstepBatch::CopyTo(unsigned int lane, Chip8& chip8) const
+{
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        chip8.registers[i] = registers[i * lanes + lane];
+        chip8.stack[i] = stack[i * lanes + lane];
+    }
+
+    chip8.keypad = 0;
+    for (unsigned int key = 0; key < 16; ++key)
+        chip8.keypad |= (keypad[key * lanes + lane] ? 1u : 0u) << key;
+
+    chip8.index = index[lane];
+    chip8.pc = pc[lane];
+    chip8.sp = sp[lane];
+    chip8.delayTimer = delayTimer[lane];
+    chip8.soundTimer = soundTimer[lane];
+    chip8.randGen = randGen[lane];
+
+    memcpy(chip8.memory, &memory[lane * MEMORY_SIZE], MEMORY_SIZE);
+    chip8.MemoryWritten(0, MEMORY_SIZE);
+
+    // Lockstep machines stay in the single plane 64x32 mode
+    chip8.hires = false;
+    chip8.planes = 1;
+    memset(chip8.video, 0, sizeof(chip8.video));
+    memcpy(chip8.video, &video[lane * VIDEO_HEIGHT], VIDEO_HEIGHT * sizeof(uint64_t));
+    chip8.MarkRowsDirty(0, VIDEO_HEIGHT - 1);
+}
+
+template <typename Group>
+void LockstepBatch::Execute(uint16_t opcode, Group const& group)
+{
+    uint8_t x = (opcode & 0x0F00u) >> 8u;
+    uint8_t y = (opcode & 0x00F0u) >> 4u;
+    uint8_t kk = opcode & 0x00FFu;
+    uint16_t nnn = opcode & 0x0FFFu;
+
+    uint8_t* vx = &registers[x * lanes];
+    uint8_t* vy = &registers[y * lanes];
+    uint8_t* vf = &registers[0xF * lanes];
+
+    // Every instruction advances the PC first, like Chip8::Cycle
+    for (unsigned int n = 0; n < group.count; ++n)
+    {
+        unsigned int l = group[n];
+        pc[l] += 2;
+    }
+
+    // Decoded the same way as the Chip8 function tables (only the nibble/byte they index by counts)
+    switch ((opcode & 0xF000u) >> 12u)
+    {
+        case 0x0:
+            if ((opcode & 0x000Fu) == 0x0u) // CLS
+            {
+                for (unsigned int n = 0; n < group.count; ++n)
+                {
+                    unsigned int l = group[n];
+                    memset(&video[l * VIDEO_HEIGHT], 0, VIDEO_HEIGHT * sizeof(uint64_t));
+                }
+            }
+            else if ((opcode & 0x000Fu) == 0xEu) // RET
+            {
+                for (unsigned int n = 0; n < group.count; ++n)
+                {
+                    unsigned int l = group[n];
+                    pc[l] = stack[(--sp[l] & 0xFu) * lanes + l];
+                }
+            }
+            break;
+
+        case 0x1: // JP addr
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] = nnn;
+            }
+            break;
+
+        case 0x2: // CALL addr
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                stack[(sp[l]++ & 0xFu) * lanes + l] = pc[l];
+                pc[l] = nnn;
+            }
+            break;
+
+        case 0x3: // SE Vx, byte
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] += (vx[l] == kk) * 2;
+            }
+            break;
+
+        case 0x4: // SNE Vx, byte
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] += (vx[l] != kk) * 2;
+            }
+            break;
+
+        case 0x5: // SE Vx, Vy
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] += (vx[l] == vy[l]) * 2;
+            }
+            break;
+
+        case 0x6: // LD Vx, byte
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                vx[l] = kk;
+            }
+            break;
+
+        case 0x7: // ADD Vx, byte
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                vx[l] += kk;
+            }
+            break;
+
+        case 0x8:
+            switch (opcode & 0x000Fu)
+            {
+                case 0x0: // LD Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        vx[l] = vy[l];
+                    }
+                    break;
+
+                case 0x1: // OR Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        vx[l] |= vy[l];
+                    }
+                    break;
+
+                case 0x2: // AND Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        vx[l] &= vy[l];
+                    }
+                    break;
+
+                case 0x3: // XOR Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        vx[l] ^= vy[l];
+                    }
+                    break;
+
+                // The flag is written after Vx, as in the Chip8 handlers (it wins when x is F)
+                case 0x4: // ADD Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint16_t sum = vx[l] + vy[l];
+                        vx[l] = sum & 0xFFu;
+                        vf[l] = sum > 255U;
+                    }
+                    break;
+
+                case 0x5: // SUB Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint8_t notBorrow = vx[l] > vy[l];
+                        vx[l] -= vy[l];
+                        vf[l] = notBorrow;
+                    }
+                    break;
+
+                case 0x6: // SHR Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint8_t source = vx[l];
+                        vx[l] = source >> 1;
+                        vf[l] = source & 0x1u;
+                    }
+                    break;
+
+                case 0x7: // SUBN Vx, Vy
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint8_t notBorrow = vy[l] > vx[l];
+                        vx[l] = vy[l] - vx[l];
+                        vf[l] = notBorrow;
+                    }
+                    break;
+
+                case 0xE: // SHL Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint8_t source = vx[l];
+                        vx[l] = source << 1;
+                        vf[l] = source >> 7u;
+                    }
+                    break;
+            }
+            break;
+
+        case 0x9: // SNE Vx, Vy
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] += (vx[l] != vy[l]) * 2;
+            }
+            break;
+
+        case 0xA: // LD I, addr
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                index[l] = nnn;
+            }
+            break;
+
+        case 0xB: // JP V0, addr
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                pc[l] = registers[l] + nnn;
+            }
+            break;
+
+        case 0xC: // RND Vx, byte
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                vx[l] = kk & randByte(randGen[l]);
+            }
+            break;
+
+        case 0xD: // DRW Vx, Vy, nibble
+        {
+            unsigned int height = opcode & 0x000Fu;
+
+            for (unsigned int n = 0; n < group.count; ++n)
+            {
+                unsigned int l = group[n];
+                uint8_t const* mem = &memory[l * MEMORY_SIZE];
+                uint64_t* screen = &video[l * VIDEO_HEIGHT];
+                unsigned int xPos = vx[l] % VIDEO_WIDTH;
+                unsigned int yPos = vy[l] % VIDEO_HEIGHT;
+                uint64_t collision = 0;
+
+                for (unsigned int row = 0; row < height; ++row)
+                {
+                    uint64_t spriteRow = static_cast<uint64_t>(mem[(index[l] + row) & 0x0FFFu]) << 56u;
+                    uint64_t line = (spriteRow >> xPos) | (xPos ? spriteRow << (VIDEO_WIDTH - xPos) : 0);
+                    uint64_t& screenRow = screen[(yPos + row) % VIDEO_HEIGHT];
+
+                    collision |= screenRow & line;
+                    screenRow ^= line;
+                }
+
+                vf[l] = collision ? 1 : 0;
+            }
+        } break;
+
+        case 0xE:
+            if ((opcode & 0x000Fu) == 0xEu) // SKP Vx
+            {
+                for (unsigned int n = 0; n < group.count; ++n)
+                {
+                    unsigned int l = group[n];
+                    pc[l] += (keypad[(vx[l] & 0xFu) * lanes + l] != 0) * 2;
+                }
+            }
+            else if ((opcode & 0x000Fu) == 0x1u) // SKNP Vx
+            {
+                for (unsigned int n = 0; n < group.count; ++n)
+                {
+                    unsigned int l = group[n];
+                    pc[l] += (keypad[(vx[l] & 0xFu) * lanes + l] == 0) * 2;
+                }
+            }
+            break;
+
+        case 0xF:
+            switch (kk)
+            {
+                case 0x07: // LD Vx, DT
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        vx[l] = delayTimer[l];
+                    }
+                    break;
+
+                case 0x0A: // LD Vx, K
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        // Lowest pressed key, or stay on this instruction
+                        unsigned int key = 0;
+                        while (key < 16 && !keypad[key * lanes + l])
+                            ++key;
+
+                        if (key < 16)
+                            vx[l] = key;
+                        else
+                            pc[l] -= 2;
+                    }
+                    break;
+
+                case 0x15: // LD DT, Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        delayTimer[l] = vx[l];
+                    }
+                    break;
+
+                case 0x18: // LD ST, Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        soundTimer[l] = vx[l];
+                    }
+                    break;
+
+                case 0x1E: // ADD I, Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        index[l] += vx[l];
+                    }
+                    break;
+
+                case 0x29: // LD F, Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        index[l] = FONTSET_START_ADDRESS + (5 * vx[l]);
+                    }
+                    break;
+
+                case 0x33: // LD B, Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        uint8_t* mem = &memory[l * MEMORY_SIZE];
+                        uint8_t value = vx[l];
+                        mem[(index[l] + 2u) & 0x0FFFu] = value % 10;
+                        mem[(index[l] + 1u) & 0x0FFFu] = (value / 10) % 10;
+                        mem[index[l] & 0x0FFFu] = value / 100;
+                    }
+                    break;
+
+                case 0x55: // LD [I], Vx
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        for (unsigned int i = 0; i <= x; ++i)
+                            memory[l * MEMORY_SIZE + ((index[l] + i) & 0x0FFFu)] = registers[i * lanes + l];
+                    }
+                    break;
+
+                case 0x65: // LD Vx, [I]
+                    for (unsigned int n = 0; n < group.count; ++n)
+                    {
+                        unsigned int l = group[n];
+                        for (unsigned int i = 0; i <= x; ++i)
+                            registers[i * lanes + l] = memory[l * MEMORY_SIZE + ((index[l] + i) & 0x0FFFu)];
+                    }
+                    break;
+            }
+            break;
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "Chip8.hpp"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Many CHIP-8 machines running the same ROM in lockstep, stored as structure of arrays
+// (one array per register holding that register for every machine, called a lane).
+// While every lane is at the same PC with the same opcode, an instruction is executed as
+// one tight loop over all lanes, which the compiler vectorizes. Once lanes diverged (skips,
+// random numbers, different input) they are grouped by PC and opcode each step: every group
+// of two or more lanes still runs as one loop, only a lane that is alone runs by itself.
+// The semantics follow the Chip8 OP_* handlers exactly, including the decoding of
+// partially specified opcodes through the function tables.
+class LockstepBatch
+{
+public:
+    explicit LockstepBatch(unsigned int lanes);
+
+    // Loads the same ROM into every lane (from a file, or from a ROM image in memory)
+    bool LoadROM(char const* filename);
+    bool LoadROM(uint8_t const* data, size_t size);
+
+    // Seeds the random number generator of a lane
+    void Seed(unsigned int lane, uint64_t seed);
+
+    // Executes cycles instructions on every lane, ticking the timers every cyclesPerFrame
+    void Run(uint64_t cycles, unsigned int cyclesPerFrame);
+
+    // Executes one instruction on every lane
+    void Step();
+
+    // Decrements the delay and sound timers of every lane (60 Hz)
+    void TickTimers();
+
+    // Copies the machine state of a lane into chip8 (e.g. to compare it against Chip8::Cycle)
+    void CopyTo(unsigned int lane, Chip8& chip8) const;
+
+    unsigned int Lanes() const { return lanes; }
+
+    // Key state of a lane
+    uint8_t& Key(unsigned int lane, unsigned int key) { return keypad[key * lanes + lane]; }
+
+    // Number of Step() calls that executed all lanes at once, and that had to group the lanes
+    uint64_t convergedSteps{};
+    uint64_t divergedSteps{};
+
+    // Instructions executed by diverged steps for lanes in a group of two or more, and for lanes alone
+    uint64_t groupedLanes{};
+    uint64_t singleLanes{};
+
+private:
+    // Lanes [first, first + count)
+    struct LaneRange
+    {
+        unsigned int first;
+        unsigned int count;
+
+        unsigned int operator[](unsigned int n) const { return first + n; }
+    };
+
+    // count lanes listed in lanes
+    struct LaneList
+    {
+        unsigned int const* lanes;
+        unsigned int count;
+
+        unsigned int operator[](unsigned int n) const { return lanes[n]; }
+    };
+
+    // Executes opcode on the lanes of group (a LaneRange or a LaneList), which are all at the same PC
+    template <typename Group>
+    void Execute(uint16_t opcode, Group const& group);
+
+    uint16_t Fetch(unsigned int lane) const
+    {
+        uint8_t const* mem = &memory[lane * MEMORY_SIZE];
+        uint16_t address = pc[lane] & 0x0FFFu;
+        return (mem[address] << 8u) | mem[(address + 1u) & 0x0FFFu];
+    }
+
+    unsigned int lanes;
+
+    // Register r of lane l lives at [r * lanes + l]
+    std::vector<uint8_t> registers;
+    std::vector<uint16_t> stack;
+    std::vector<uint8_t> keypad;
+
+    // One element per lane
+    std::vector<uint16_t> index;
+    std::vector<uint16_t> pc;
+    std::vector<uint8_t> sp;
+    std::vector<uint8_t> delayTimer;
+    std::vector<uint8_t> soundTimer;
+    std::vector<RandomEngine> randGen;
+
+    // Step() scratch: (PC << 16 | opcode) of each lane, and the lanes sorted by it
+    std::vector<uint32_t> stepKeys;
+    std::vector<unsigned int> stepOrder;
+
+    // Per lane blocks: MEMORY_SIZE bytes of memory and VIDEO_HEIGHT rows of video each
+    std::vector<uint8_t> memory;
+    std::vector<uint64_t> video;
+
+    std::uniform_int_distribution<uint8_t> randByte;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "Movie.hpp"
+#include "ByteOrder.hpp"
+#include "Idle.hpp"
+#include "Profile.hpp"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const uint8_t MOVIE_MAGIC[4] = {'C', '8', 'M', 'V'};
+}
+
+void Movie::RecordKeypad(uint64_t cycle, uint16_t keys)
+{
+    uint16_t last = events.empty() ? 0 : events.back().keys;
+
+    if (keys != last)
+    {
+        MovieEvent event;
+        event.cycle = cycle;
+        event.keys = keys;
+        events.push_back(event);
+    }
+}
+
+bool WriteMovieFile(char const* filename, Movie const& movie)
+{
+    std::vector<uint8_t> buffer(MOVIE_HEADER_SIZE + movie.events.size() * MOVIE_EVENT_SIZE);
+
+    memcpy(buffer.data(), MOVIE_MAGIC, 4);
+    Put16(&buffer[4], MOVIE_VERSION);
+    buffer[6] = static_cast<uint8_t>(movie.quirks);
+    buffer[7] = 0;
+    Put64(&buffer[8], movie.romHash);
+    Put32(&buffer[16], movie.seed);
+    Put32(&buffer[20], movie.cyclesPerFrame);
+    Put64(&buffer[24], movie.cycles);
+    Put64(&buffer[32], movie.videoHash);
+    Put32(&buffer[40], static_cast<uint32_t>(movie.events.size()));
+    Put32(&buffer[44], 0);
+
+    for (size_t i = 0; i < movie.events.size(); ++i)
+    {
+        uint8_t* out = &buffer[MOVIE_HEADER_SIZE + i * MOVIE_EVENT_SIZE];
+        Put64(out, movie.events[i].cycle);
+        Put16(out + 8, movie.events[i].keys);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+    return static_cast<bool>(file);
+}
+
+bool ReadMovieFile(char const* filename, Movie& movie)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (file.gcount() != static_cast<std::streamsize>(sizeof(header)) ||
+        memcmp(header, MOVIE_MAGIC, 4) != 0 || Get16(header + 4) != MOVIE_VERSION ||
+        header[6] > static_cast<uint8_t>(QuirkProfile::XoChip) || Get32(header + 20) == 0)
+        return false;
+
+    Movie read;
+    read.quirks = static_cast<QuirkProfile>(header[6]);
+    read.romHash = Get64(header + 8);
+    read.seed = Get32(header + 16);
+    read.cyclesPerFrame = Get32(header + 20);
+    read.cycles = Get64(header + 24);
+    read.videoHash = Get64(header + 32);
+
+    uint32_t count = Get32(header + 40);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t in[MOVIE_EVENT_SIZE];
+        file.read(reinterpret_cast<char*>(in), sizeof(in));
+        if (file.gcount() != static_cast<std::streamsize>(sizeof(in)))
+            return false;
+
+        MovieEvent event;
+        event.cycle = Get64(in);
+        event.keys = Get16(in + 8);
+
+        // Events are in playback order
+        if (!read.events.empty() && event.cycle < read.events.back().cycle)
+            return false;
+
+        read.events.push_back(event);
+    }
+
+    movie = std::move(read);
+    return true;
+}
+
+HeadlessResult ReplayMovie(Chip8& chip8, Movie const& movie, Engine engine, bool skipIdle)
+{
+    HeadlessResult result;
+    unsigned int frameCycles = 0; // Instructions executed in the current frame
+    size_t next = 0;              // Next keypad event
+    IdleDetector idle;
+
+    chip8.randGen.seed(static_cast<RandomEngine::result_type>(movie.seed));
+    chip8.keypad = 0;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    while (result.cycles < movie.cycles)
+    {
+        // Keys pressed or released before this instruction
+        while (next < movie.events.size() && movie.events[next].cycle <= result.cycles)
+        {
+            chip8.keypad = movie.events[next++].keys;
+            idle.Reset();
+        }
+
+        // Never run past the end of the frame, the next keypad change or the movie
+        unsigned int budget = movie.cyclesPerFrame - frameCycles;
+        if (movie.cycles - result.cycles < budget)
+            budget = static_cast<unsigned int>(movie.cycles - result.cycles);
+        if (next < movie.events.size() && movie.events[next].cycle - result.cycles < budget)
+            budget = static_cast<unsigned int>(movie.events[next].cycle - result.cycles);
+
+        uint16_t pc = chip8.pc;
+        unsigned int executed = chip8.Step(engine, budget);
+        if (skipIdle)
+            executed += idle.Skip(chip8, pc, executed, budget - executed);
+
+        result.cycles += executed;
+        frameCycles += executed;
+
+        // Emulated frame boundary
+        if (frameCycles == movie.cyclesPerFrame)
+        {
+            idle.BeforeTick(chip8);
+            chip8.TickTimers();
+            CHIP8_PROFILE_END_FRAME(chip8.profile);
+            frameCycles = 0;
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+    result.idleCycles = idle.Skipped();
+
+    return result;
+}
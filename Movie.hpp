@@ -0,0 +1,67 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "Chip8.hpp"
+#include "Headless.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Movie format: everything needed to replay a session deterministically, in a fixed
+// little-endian byte layout. A replay starts from the freshly loaded ROM with the recorded
+// seed, applies every keypad change at its cycle and checks the final video hash.
+//
+//   offset  size  field
+//        0     4  magic "C8MV"
+//        4     2  version
+//        6     1  quirk profile (QuirkProfile value)
+//        7     1  reserved (0)
+//        8     8  ROM hash (HashRom)
+//       16     4  random number generator seed
+//       20     4  instructions per frame
+//       24     8  total number of instructions
+//       32     8  final video hash (HashVideo)
+//       40     4  number of keypad events (N)
+//       44     4  reserved (0)
+//       48  N*10  keypad events, by increasing cycle:
+//                    0  8  cycle (instructions executed before the change)
+//                    8  2  keypad state (bit k = key k held)
+const uint16_t MOVIE_VERSION = 1;
+const size_t MOVIE_HEADER_SIZE = 48;
+const size_t MOVIE_EVENT_SIZE = 10;
+
+// The keypad state from cycle on
+struct MovieEvent
+{
+    uint64_t cycle{};
+    uint16_t keys{};
+};
+
+struct Movie
+{
+    QuirkProfile quirks{QuirkProfile::Default};
+    uint64_t romHash{};
+    uint32_t seed{};
+    unsigned int cyclesPerFrame{DEFAULT_CYCLES_PER_FRAME};
+    uint64_t cycles{};    // Length of the session in instructions
+    uint64_t videoHash{}; // Video at the end of the session
+    std::vector<MovieEvent> events;
+
+    // Appends an event when keys (bit k = key k held, like Chip8::keypad) differ from the last
+    // recorded state (all keys are up at the start). Cycles must not decrease between calls.
+    void RecordKeypad(uint64_t cycle, uint16_t keys);
+};
+
+bool WriteMovieFile(char const* filename, Movie const& movie);
+
+// Returns false when the file cannot be read or is not a movie of this version
+bool ReadMovieFile(char const* filename, Movie& movie);
+
+// Replays a movie on chip8, which must have the movie's ROM loaded and quirk profile:
+// seeds the random number generator, then runs exactly movie.cycles instructions at full
+// speed in frames of movie.cyclesPerFrame (like FrameScheduler), setting the keypad from
+// the events on the way. There is no halt detection, a session never stops early either.
+// With skipIdle the passes of busy-wait loops are skipped up to the next frame or event.
+HeadlessResult ReplayMovie(Chip8& chip8, Movie const& movie, Engine engine = Engine::Interpreter, bool skipIdle = false);
+
+#endif
@@ -1,237 +1,182 @@
 #include "Platform.hpp"
+#include <cstring>
 
 Platform::Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight)
+    : textureWidth(textureWidth), textureHeight(textureHeight), pixels(textureWidth * textureHeight)
 {
     SDL_Init(SDL_INIT_VIDEO);
 
     window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Presents wait for the display refresh, which only paces the render thread
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
     texture = SDL_CreateTexture(
         renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
         textureWidth, textureHeight);
+
+    SetKeymap(DefaultKeymap());
 }
 
 Platform::~Platform()
 {
-    // Basically steps of Constructor in reverse
+    // Basically steps of Constructor in reverse (the audio callback reads audioRing)
+    if (audioDevice)
+        SDL_CloseAudioDevice(audioDevice);
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
-void Platform::Update(void const* buffer, int pitch)
+namespace
+{
+    // RGBA of the four colors of two planes (bit p = plane p)
+    const uint32_t PALETTE[4] = {0x00000000u, 0xFFFFFFFFu, 0xAAAAAAFFu, 0x555555FFu};
+}
+
+void Platform::Update(uint64_t const* plane0, uint64_t const* plane1, int width, int height, int firstRow, int rowCount)
 {
-    // Fetch the new texture
-    SDL_UpdateTexture(texture, nullptr, buffer, pitch); 
+    // The dirty range may still cover rows of a larger mode the machine just left
+    if (firstRow + rowCount > height)
+        rowCount = height - firstRow;
+
+    int rowWords = width / 64;
+
+    // Expand the changed rows to one RGBA value per pixel, a word of each plane at a time
+    for (int y = firstRow; y < firstRow + rowCount; ++y)
+    {
+        uint32_t* pixel = &pixels[y * textureWidth];
+
+        for (int w = 0; w < rowWords; ++w, pixel += 64)
+        {
+            uint64_t bits0 = plane0[y * rowWords + w];
+
+            if (!plane1)
+            {
+                // Single plane: 0x00000000 or 0xFFFFFFFF
+                for (int x = 0; x < 64; ++x)
+                    pixel[x] = 0u - static_cast<uint32_t>((bits0 >> (63 - x)) & 1u);
+                continue;
+            }
+
+            uint64_t bits1 = plane1[y * rowWords + w];
+
+            for (int x = 0; x < 64; ++x)
+                pixel[x] = PALETTE[((bits0 >> (63 - x)) & 1u) | (((bits1 >> (63 - x)) & 1u) << 1)];
+        }
+    }
+
+    // Fetch only the changed rows of the new texture
+    if (rowCount > 0)
+    {
+        int pitch = textureWidth * sizeof(uint32_t);
+        SDL_Rect dirty{0, firstRow, width, rowCount};
+        SDL_UpdateTexture(texture, &dirty, &pixels[firstRow * textureWidth], pitch);
+    }
 
     // Clear the renderer
     SDL_RenderClear(renderer); 
 
-    // Copy the new texture to the renderer
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    // Copy the part of the texture used by the current mode to the renderer
+    SDL_Rect screen{0, 0, width, height};
+    SDL_RenderCopy(renderer, texture, &screen, nullptr);
 
     // Apply the texture to the renderer
     SDL_RenderPresent(renderer);
 }
 
-bool Platform::ProcessInput(uint8_t* keys)
+namespace
+{
+    // Runs on SDL's audio thread: plays the buffered samples, silence when the ring runs dry
+    void AudioCallback(void* userdata, Uint8* stream, int length)
+    {
+        int16_t* samples = reinterpret_cast<int16_t*>(stream);
+        size_t count = length / sizeof(int16_t);
+        size_t read = static_cast<SampleRing*>(userdata)->Read(samples, count);
+        memset(samples + read, 0, (count - read) * sizeof(int16_t));
+    }
+}
+
+SampleRing* Platform::OpenAudio(unsigned int sampleRate, unsigned int bufferSamples)
+{
+    if (audioDevice || SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        return nullptr;
+
+    audioRing.reset(new SampleRing(2 * bufferSamples + sampleRate / TIMER_FREQUENCY));
+
+    SDL_AudioSpec wanted{};
+    wanted.freq = static_cast<int>(sampleRate);
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = static_cast<Uint16>(bufferSamples);
+    wanted.callback = AudioCallback;
+    wanted.userdata = audioRing.get();
+
+    // No changes allowed: the samples are rendered at exactly this format
+    audioDevice = SDL_OpenAudioDevice(nullptr, 0, &wanted, nullptr, 0);
+    if (!audioDevice)
+    {
+        audioRing.reset();
+        return nullptr;
+    }
+
+    SDL_PauseAudioDevice(audioDevice, 0);
+    return audioRing.get();
+}
+
+bool Platform::SetKeymap(Keymap const& keymap)
+{
+    bool known = true;
+    memset(keyTable, -1, sizeof(keyTable));
+
+    for (KeyBinding const& binding : keymap)
+    {
+        // Names are resolved with the current keyboard layout, events are then looked up by scancode
+        SDL_Scancode scancode = SDL_GetScancodeFromKey(SDL_GetKeyFromName(binding.hostKey.c_str()));
+        if (scancode == SDL_SCANCODE_UNKNOWN || binding.key > 0xF)
+            known = false;
+        else
+            keyTable[scancode] = static_cast<int8_t>(binding.key);
+    }
+
+    return known;
+}
+
+bool Platform::ProcessInput()
 {
     bool quit = false;
     SDL_Event event;
 
     while (SDL_PollEvent(&event))
     {
-        switch(event.type)
+        switch (event.type)
         {
-            // When exit 
             case SDL_QUIT:
-            {
                 quit = true;
-            } break;
+                break;
 
-            // When user presses the key
             case SDL_KEYDOWN:
-            {
-                switch (event.key.keysym.sym)
-                {
-                    case SDLK_ESCAPE:
-                    {
-                        quit = true;
-                    } break;
-
-                    case SDLK_x:
-                    {
-                        keys[0] = 1;
-                    } break;
-
-                    case SDLK_1:
-                    {
-                        keys[1] = 1;
-                    } break;
-
-                    case SDLK_2:
-                    {
-                        keys[2] = 1;
-                    } break;
-
-                    case SDLK_3:
-                    {
-                        keys[3] = 1;
-                    } break;
-
-                    case SDLK_q:
-                    {
-                        keys[4] = 1;
-                    } break;
-
-                    case SDLK_w:
-                    {
-                        keys[5] = 1;
-                    } break;
-
-                    case SDLK_e:
-                    {
-                        keys[6] = 1;
-                    } break;
-
-                    case SDLK_a:
-                    {
-                        keys[7] = 1;
-                    } break;
-
-                    case SDLK_s:
-                    {
-                        keys[8] = 1;
-                    } break;
-
-                    case SDLK_d:
-                    {
-                        keys[9] = 1;
-                    } break;
-
-                    case SDLK_z:
-                    {
-                        keys[0xA] = 1;
-                    } break;
-
-                    case SDLK_c:
-                    {
-                        keys[0xB] = 1;
-                    } break;
-
-                    case SDLK_4:
-                    {
-                        keys[0xC] = 1;
-                    } break;
-
-                    case SDLK_r:
-                    {
-                        keys[0xD] = 1;
-                    } break;
-
-                    case SDLK_f:
-                    {
-                        keys[0xE] = 1;
-                    } break;
-
-                    case SDLK_v:
-                    {
-                        keys[0xF] = 1;
-                    } break;
-                }
-            } break;
-
-            // When user releases the key
             case SDL_KEYUP:
             {
-                switch (event.key.keysym.sym)
+                bool down = event.type == SDL_KEYDOWN;
+                SDL_Keycode sym = event.key.keysym.sym;
+
+                if (sym == SDLK_ESCAPE && down)
+                    quit = true;
+                else if (sym == SDLK_BACKSPACE)
+                    rewindHeld = down;
+                else if (!event.key.repeat)
                 {
-                    case SDLK_x:
-                    {
-                        keys[0] = 0;
-                    } break;
-
-                    case SDLK_1:
-                    {
-                        keys[1] = 0;
-                    } break;
-
-                    case SDLK_2:
-                    {
-                        keys[2] = 0;
-                    } break;
-
-                    case SDLK_3:
-                    {
-                        keys[3] = 0;
-                    } break;
-
-                    case SDLK_q:
-                    {
-                        keys[4] = 0;
-                    } break;
-
-                    case SDLK_w:
-                    {
-                        keys[5] = 0;
-                    } break;
-
-                    case SDLK_e:
-                    {
-                        keys[6] = 0;
-                    } break;
-
-                    case SDLK_a:
-                    {
-                        keys[7] = 0;
-                    } break;
-
-                    case SDLK_s:
-                    {
-                        keys[8] = 0;
-                    } break;
-
-                    case SDLK_d:
-                    {
-                        keys[9] = 0;
-                    } break;
-
-                    case SDLK_z:
-                    {
-                        keys[0xA] = 0;
-                    } break;
-
-                    case SDLK_c:
-                    {
-                        keys[0xB] = 0;
-                    } break;
-
-                    case SDLK_4:
-                    {
-                        keys[0xC] = 0;
-                    } break;
-
-                    case SDLK_r:
-                    {
-                        keys[0xD] = 0;
-                    } break;
-
-                    case SDLK_f:
-                    {
-                        keys[0xE] = 0;
-                    } break;
-
-                    case SDLK_v:
-                    {
-                        keys[0xF] = 0;
-                    } break;
+                    int8_t key = keyTable[event.key.keysym.scancode];
+                    if (key >= 0 && down)
+                        keys.Press(key);
+                    else if (key >= 0)
+                        keys.Release(key);
                 }
             } break;
         }
     }
 
     return quit;
-}
\ No newline at end of file
+}
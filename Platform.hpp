@@ -1,8 +1,13 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
+#include "Audio.hpp"
+#include "Keymap.hpp"
 #include <SDL2/SDL.h>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 class Platform
 {
@@ -13,14 +18,44 @@ public:
     // Destructor
     ~Platform();
 
-    void Update(void const* buffer, int pitch);
+    // Expands rows [firstRow, firstRow + rowCount) of a width x height framebuffer of one or two
+    // 1 bit per pixel planes (width / 64 words per row, leftmost pixel in the most significant bit,
+    // plane1 may be nullptr) to RGBA, uploads them and presents the top-left width x height of the
+    // texture (the texture is sized for the largest mode)
+    void Update(uint64_t const* plane0, uint64_t const* plane1, int width, int height, int firstRow, int rowCount);
 
-    bool ProcessInput(uint8_t* keys);
+    // Binds the host keys of keymap (the constructor sets DefaultKeymap()). Returns false when
+    // a host key name is unknown to SDL or a key is out of range; the other bindings still apply.
+    bool SetKeymap(Keymap const& keymap);
+
+    // Handles the pending window events, feeding key presses and releases to Keypad().
+    // Returns true when the window should close.
+    bool ProcessInput();
+
+    // The keys collected by ProcessInput, latched by the emulation thread once per frame
+    KeypadLatch& Keypad() { return keys; }
+
+    // Opens the audio device, playing 16-bit mono samples at sampleRate from the returned ring
+    // (feed it through a RingAudioSink) in buffers of bufferSamples samples. The ring holds two
+    // device buffers and a frame of samples, which bounds the latency. Returns nullptr when
+    // there is no audio device.
+    SampleRing* OpenAudio(unsigned int sampleRate, unsigned int bufferSamples);
+
+    // Whether the rewind key (Backspace) is held down (safe to call from another thread)
+    bool RewindHeld() const { return rewindHeld.load(std::memory_order_relaxed); }
 
 private:
     SDL_Window* window{};
     SDL_Renderer* renderer{};
     SDL_Texture* texture{};    
+    int textureWidth{};
+    int textureHeight{};
+    std::vector<uint32_t> pixels; // RGBA staging buffer for texture uploads
+    std::atomic<bool> rewindHeld{};
+    int8_t keyTable[SDL_NUM_SCANCODES]; // CHIP-8 key of every scancode, -1 when unbound
+    KeypadLatch keys;
+    SDL_AudioDeviceID audioDevice{};
+    std::unique_ptr<SampleRing> audioRing; // Read by the audio callback
 };
 
 #endif
\ No newline at end of file
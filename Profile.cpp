@@ -0,0 +1,154 @@
+#include "Profile.hpp"
+
+#ifdef CHIP8_PROFILE
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    unsigned int Bucket(uint64_t value)
+    {
+        unsigned int bucket = 0;
+        while (value)
+        {
+            ++bucket;
+            value >>= 1;
+        }
+        return bucket;
+    }
+
+    // Mnemonic-style name of an opcode family, e.g. "8xy4" or "Fx55"
+    void FamilyName(unsigned int top, unsigned int family, char* name)
+    {
+        static char const hex[] = "0123456789ABCDEF";
+
+        switch (top)
+        {
+            case 0x0: std::sprintf(name, "00%02X", family); break;
+            case 0x8: std::sprintf(name, "8xy%c", hex[family]); break;
+            case 0xE: std::sprintf(name, "Ex%c%c", family == 0xE ? '9' : 'A', hex[family]); break;
+            case 0xF: std::sprintf(name, "Fx%c%c", hex[family >> 4], hex[family & 0xF]); break;
+            case 0x1: case 0x2: case 0xA: case 0xB: std::sprintf(name, "%cnnn", hex[top]); break;
+            case 0x5: case 0x9: std::sprintf(name, "%cxy0", hex[top]); break;
+            case 0xD: std::sprintf(name, "Dxyn"); break;
+            default: std::sprintf(name, "%cxkk", hex[top]); break;
+        }
+    }
+
+    void WriteHistogram(std::ostream& out, uint64_t const* buckets)
+    {
+        out << '[';
+        for (unsigned int i = 0; i < Profile::HISTOGRAM_BUCKETS; ++i)
+            out << (i ? ", " : "") << buckets[i];
+        out << ']';
+    }
+
+    void WriteTimeStat(std::ostream& out, char const* name, TimeStat const& stat)
+    {
+        out << "  \"" << name << "\": {\"calls\": " << stat.calls << ", \"total_ns\": " << stat.totalNs
+            << ", \"max_ns\": " << stat.maxNs << "},\n";
+    }
+}
+
+void Profile::EndFrame()
+{
+    Clock::time_point now = Clock::now();
+
+    if (frames == 0)
+        firstFrameEnd = now;
+    else
+        ++frameMicroseconds[Bucket(std::chrono::duration_cast<std::chrono::microseconds>(now - lastFrameEnd).count())];
+
+    ++instructionsPerFrame[Bucket(instructions - frameStartInstructions)];
+    frameStartInstructions = instructions;
+
+    lastFrameEnd = now;
+    ++frames;
+}
+
+bool Profile::WriteJson(char const* filename) const
+{
+    std::ofstream out(filename);
+    if (!out.is_open())
+        return false;
+
+    double seconds = std::chrono::duration<double>(lastFrameEnd - firstFrameEnd).count();
+    double fps = frames > 1 && seconds > 0.0 ? (frames - 1) / seconds : 0.0;
+
+    out << "{\n"
+        << "  \"instructions\": " << instructions << ",\n"
+        << "  \"frames\": " << frames << ",\n"
+        << "  \"fps\": " << fps << ",\n"
+        << "  \"histogram_buckets\": \"0, then [2^(i-1), 2^i) for bucket i\",\n"
+        << "  \"instructions_per_frame\": ";
+    WriteHistogram(out, instructionsPerFrame);
+    out << ",\n  \"frame_microseconds\": ";
+    WriteHistogram(out, frameMicroseconds);
+    out << ",\n";
+
+    WriteTimeStat(out, "platform_update", update);
+    WriteTimeStat(out, "platform_input", input);
+
+    // Opcode families
+    out << "  \"opcodes\": {";
+    bool first = true;
+    for (unsigned int top = 0; top < 16; ++top)
+    {
+        for (unsigned int family = 0; family < 256; ++family)
+        {
+            if (!opcodeCounts[top][family])
+                continue;
+
+            char name[8];
+            FamilyName(top, family, name);
+            out << (first ? "\n" : ",\n") << "    \"" << name << "\": " << opcodeCounts[top][family];
+            first = false;
+        }
+    }
+    out << "\n  },\n";
+
+    // PC heatmap, executed addresses only
+    out << "  \"pc\": {";
+    first = true;
+    for (unsigned int address = 0; address < ADDRESSES; ++address)
+    {
+        if (!pcCounts[address])
+            continue;
+
+        char name[8];
+        std::sprintf(name, "%03X", address);
+        out << (first ? "\n" : ",\n") << "    \"" << name << "\": " << pcCounts[address];
+        first = false;
+    }
+    out << "\n  }\n}\n";
+
+    return static_cast<bool>(out);
+}
+
+bool Profile::WriteFolded(char const* filename) const
+{
+    std::ofstream out(filename);
+    if (!out.is_open())
+        return false;
+
+    // The opcode family is the parent frame of the address, so the flame graph
+    // shows the cost per instruction type first and per location second
+    for (unsigned int address = 0; address < ADDRESSES; ++address)
+    {
+        if (!pcCounts[address])
+            continue;
+
+        uint16_t opcode = pcOpcodes[address];
+        char family[8];
+        FamilyName(opcode >> 12u, OpcodeFamily(opcode), family);
+
+        char name[8];
+        std::sprintf(name, "%03X", address);
+        out << "chip8;" << family << ';' << name << ' ' << pcCounts[address] << '\n';
+    }
+
+    return static_cast<bool>(out);
+}
+
+#endif
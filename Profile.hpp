@@ -0,0 +1,123 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Hot-path profiler, compiled in only when CHIP8_PROFILE is defined (CMake: -DCHIP8_PROFILER=ON).
+// Without it the CHIP8_PROFILE_* macros expand to nothing and Chip8 has no profile member.
+
+#ifdef CHIP8_PROFILE
+
+#include <chrono>
+#include <cstdint>
+
+// Call count and time of a timed section
+struct TimeStat
+{
+    uint64_t calls{};
+    uint64_t totalNs{};
+    uint64_t maxNs{};
+
+    void Add(uint64_t ns)
+    {
+        ++calls;
+        totalNs += ns;
+        if (ns > maxNs)
+            maxNs = ns;
+    }
+};
+
+// Counters of one machine
+class Profile
+{
+public:
+    static const unsigned int ADDRESSES = 4096;
+    static const unsigned int HISTOGRAM_BUCKETS = 33; // 0, then [2^(i-1), 2^i) for bucket i
+
+    uint64_t instructions{};
+    uint64_t pcCounts[ADDRESSES]{};        // Instructions executed at each address
+    uint16_t pcOpcodes[ADDRESSES]{};       // Last opcode executed at each address
+    uint64_t opcodeCounts[16][256]{};      // Indexed by OpcodeFamily()
+    uint64_t instructionsPerFrame[HISTOGRAM_BUCKETS]{};
+    uint64_t frameMicroseconds[HISTOGRAM_BUCKETS]{}; // Host time between frame ends
+    uint64_t frames{};
+
+    TimeStat update; // Platform::Update
+    TimeStat input;  // Platform::ProcessInput
+
+    void CountInstruction(uint16_t address, uint16_t opcode)
+    {
+        ++instructions;
+        ++pcCounts[address & (ADDRESSES - 1)];
+        pcOpcodes[address & (ADDRESSES - 1)] = opcode;
+        ++opcodeCounts[opcode >> 12u][OpcodeFamily(opcode)];
+    }
+
+    // Records the end of an emulated frame
+    void EndFrame();
+
+    // The part of an opcode the function tables dispatch on besides the top nibble
+    // (low nibble for 8/E, low byte for 0/F, nothing for the others)
+    static uint8_t OpcodeFamily(uint16_t opcode)
+    {
+        switch (opcode >> 12u)
+        {
+            case 0x8: case 0xE: return opcode & 0x000Fu;
+            case 0x0: case 0xF: return opcode & 0x00FFu;
+        }
+
+        return 0;
+    }
+
+    // Writes the counters as JSON
+    bool WriteJson(char const* filename) const;
+
+    // Writes "chip8;<opcode family>;<address> <count>" lines for flamegraph.pl / speedscope.
+    // Self-modified addresses are attributed to the last opcode executed there.
+    bool WriteFolded(char const* filename) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t frameStartInstructions{};
+    Clock::time_point firstFrameEnd;
+    Clock::time_point lastFrameEnd;
+};
+
+// Adds the lifetime of the object to a TimeStat (if any)
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(TimeStat* stat)
+        : stat(stat), start(stat ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        if (stat)
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stat->Add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    TimeStat* stat;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define CHIP8_PROFILE_INSTRUCTION(profile, address, opcode) \
+    do { if (profile) (profile)->CountInstruction(address, opcode); } while (0)
+#define CHIP8_PROFILE_END_FRAME(profile) \
+    do { if (profile) (profile)->EndFrame(); } while (0)
+#define CHIP8_PROFILE_SCOPE(profile, stat) \
+    ScopedTimer profileTimer_##stat((profile) ? &(profile)->stat : nullptr)
+
+#else
+
+#define CHIP8_PROFILE_INSTRUCTION(profile, address, opcode) do {} while (0)
+#define CHIP8_PROFILE_END_FRAME(profile) do {} while (0)
+#define CHIP8_PROFILE_SCOPE(profile, stat) do {} while (0)
+
+#endif
+
+#endif
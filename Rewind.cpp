@@ -0,0 +1,149 @@
+#include "Rewind.hpp"
+#include <algorithm>
+#include <cstring>
+
+RewindBuffer::RewindBuffer(unsigned int maxCheckpoints, size_t poolBytes)
+    : records(maxCheckpoints > 0 ? maxCheckpoints : 1),
+      pool(std::max(poolBytes / sizeof(uint64_t), size_t(MEMORY_SIZE / sizeof(uint64_t) + VIDEO_WORDS))),
+      latest(SNAPSHOT_SIZE),
+      next(SNAPSHOT_SIZE)
+{
+}
+
+void RewindBuffer::Reset(Chip8& chip8)
+{
+    first = 0;
+    count = 0;
+    slotsUsed = 0;
+
+    SaveSnapshot(chip8, latest.data(), latest.size());
+    chip8.ClearWrittenPages();
+}
+
+void RewindBuffer::Checkpoint(Chip8& chip8)
+{
+    SaveSnapshot(chip8, next.data(), next.size());
+
+    uint8_t const* oldMemory = latest.data() + SNAPSHOT_MEMORY_OFFSET;
+    uint8_t const* newMemory = next.data() + SNAPSHOT_MEMORY_OFFSET;
+    uint8_t const* oldVideo = latest.data() + SNAPSHOT_VIDEO_OFFSET;
+    uint8_t const* newVideo = next.data() + SNAPSHOT_VIDEO_OFFSET;
+
+    // Only pages written since the last checkpoint can differ
+    uint64_t pages = 0;
+    for (unsigned int page = 0; page < MEMORY_SIZE / MEMORY_PAGE_SIZE; ++page)
+    {
+        unsigned int offset = page * MEMORY_PAGE_SIZE;
+        if (((chip8.writtenPages >> page) & 1u) && memcmp(oldMemory + offset, newMemory + offset, MEMORY_PAGE_SIZE) != 0)
+            pages |= 1ull << page;
+    }
+
+    uint64_t words[VIDEO_WORDS / 64]{};
+    for (unsigned int word = 0; word < VIDEO_WORDS; ++word)
+    {
+        if (memcmp(oldVideo + 8 * word, newVideo + 8 * word, 8) != 0)
+            words[word / 64] |= 1ull << (word % 64);
+    }
+
+    unsigned int slots = 0;
+    for (uint64_t p = pages; p; p &= p - 1)
+        slots += SLOTS_PER_PAGE;
+    for (uint64_t w : words)
+        for (; w; w &= w - 1)
+            ++slots;
+
+    // Make room, oldest first
+    while (count > 0 && (count == records.size() || slotsUsed + slots > pool.size()))
+        DropOldest();
+
+    // The undo record of the previous checkpoint: its state and the bytes about to be overwritten
+    UndoRecord& record = records[(first + count) % records.size()];
+    memcpy(record.state, latest.data(), STATE_SIZE);
+    record.pages = pages;
+    memcpy(record.words, words, sizeof(words));
+    record.firstSlot = count > 0 ? (records[(first + count - 1) % records.size()].firstSlot +
+                                    records[(first + count - 1) % records.size()].slots) % pool.size()
+                                 : 0;
+    record.slots = slots;
+
+    size_t slot = record.firstSlot;
+    for (unsigned int page = 0; page < MEMORY_SIZE / MEMORY_PAGE_SIZE; ++page)
+    {
+        if ((pages >> page) & 1u)
+        {
+            CopyToPool(slot, oldMemory + page * MEMORY_PAGE_SIZE, SLOTS_PER_PAGE);
+            slot += SLOTS_PER_PAGE;
+        }
+    }
+    for (unsigned int word = 0; word < VIDEO_WORDS; ++word)
+    {
+        if ((words[word / 64] >> (word % 64)) & 1u)
+            CopyToPool(slot++, oldVideo + 8 * word, 1);
+    }
+
+    ++count;
+    slotsUsed += slots;
+
+    latest.swap(next);
+    chip8.ClearWrittenPages();
+}
+
+bool RewindBuffer::Rewind(Chip8& chip8, unsigned int checkpoints)
+{
+    if (checkpoints > count)
+        return false;
+
+    uint8_t* memory = latest.data() + SNAPSHOT_MEMORY_OFFSET;
+    uint8_t* video = latest.data() + SNAPSHOT_VIDEO_OFFSET;
+
+    // Undo the newest records one by one
+    for (unsigned int i = 0; i < checkpoints; ++i)
+    {
+        UndoRecord const& record = records[(first + count - 1) % records.size()];
+
+        size_t slot = record.firstSlot;
+        for (unsigned int page = 0; page < MEMORY_SIZE / MEMORY_PAGE_SIZE; ++page)
+        {
+            if ((record.pages >> page) & 1u)
+            {
+                CopyFromPool(slot, memory + page * MEMORY_PAGE_SIZE, SLOTS_PER_PAGE);
+                slot += SLOTS_PER_PAGE;
+            }
+        }
+        for (unsigned int word = 0; word < VIDEO_WORDS; ++word)
+        {
+            if ((record.words[word / 64] >> (word % 64)) & 1u)
+                CopyFromPool(slot++, video + 8 * word, 1);
+        }
+
+        memcpy(latest.data(), record.state, STATE_SIZE);
+
+        --count;
+        slotsUsed -= record.slots;
+    }
+
+    // Restoring only copies the memory chunks that differ from the machine's current memory
+    RestoreSnapshot(chip8, latest.data(), latest.size());
+    chip8.ClearWrittenPages();
+
+    return true;
+}
+
+void RewindBuffer::CopyToPool(size_t slot, uint8_t const* source, unsigned int slots)
+{
+    for (unsigned int i = 0; i < slots; ++i)
+        memcpy(&pool[(slot + i) % pool.size()], source + 8 * i, 8);
+}
+
+void RewindBuffer::CopyFromPool(size_t slot, uint8_t* destination, unsigned int slots) const
+{
+    for (unsigned int i = 0; i < slots; ++i)
+        memcpy(destination + 8 * i, &pool[(slot + i) % pool.size()], 8);
+}
+
+void RewindBuffer::DropOldest()
+{
+    slotsUsed -= records[first].slots;
+    first = (first + 1) % records.size();
+    --count;
+}
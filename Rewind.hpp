@@ -0,0 +1,71 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "Chip8.hpp"
+#include "Snapshot.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ring buffer of machine checkpoints for frame-accurate rewind.
+// Only the latest checkpoint is kept in full (as a snapshot). Every older checkpoint
+// is an undo record: its registers/timers/etc. plus the memory pages and video words
+// that changed on the way to the next checkpoint, as they were before the change.
+// Dropping the oldest checkpoint therefore never affects the others, and a frame that
+// writes nothing to memory costs under two hundred bytes. All storage is allocated up front.
+class RewindBuffer
+{
+public:
+    // maxCheckpoints undo records, sharing poolBytes of storage for pages and video words
+    RewindBuffer(unsigned int maxCheckpoints, size_t poolBytes);
+
+    // Drops the history and makes the current state of chip8 the latest checkpoint
+    void Reset(Chip8& chip8);
+
+    // Records the current state of chip8 as the latest checkpoint, evicting the oldest
+    // checkpoints when out of room
+    void Checkpoint(Chip8& chip8);
+
+    // Returns chip8 to the checkpoint `checkpoints` steps before the latest one
+    // (0 = the latest checkpoint itself), forgetting the newer ones.
+    // Returns false, leaving chip8 untouched, when the history is not that long.
+    bool Rewind(Chip8& chip8, unsigned int checkpoints);
+
+    // Number of checkpoints that can be rewound to (besides the latest)
+    unsigned int Count() const { return count; }
+
+    // Bytes of page/video word storage used by the undo records
+    size_t BytesUsed() const { return slotsUsed * sizeof(uint64_t); }
+
+private:
+    // Registers, stack, timers, keypad, RNG, display mode and audio (the snapshot bytes before the video)
+    static const size_t STATE_SIZE = SNAPSHOT_VIDEO_OFFSET;
+
+    struct UndoRecord
+    {
+        uint8_t state[STATE_SIZE];
+        uint64_t pages{};      // Memory pages saved in the pool (bit per page)
+        uint64_t words[VIDEO_WORDS / 64]{}; // Video words saved in the pool (bit per word)
+        size_t firstSlot{};    // Pool slot of the first saved page/word
+        unsigned int slots{};  // Number of pool slots used
+    };
+
+    // Pool slots hold 8 bytes: a page takes MEMORY_PAGE_SIZE / 8 slots and a video word one
+    static const unsigned int SLOTS_PER_PAGE = MEMORY_PAGE_SIZE / sizeof(uint64_t);
+
+    void CopyToPool(size_t slot, uint8_t const* source, unsigned int slots);
+    void CopyFromPool(size_t slot, uint8_t* destination, unsigned int slots) const;
+    void DropOldest();
+
+    std::vector<UndoRecord> records; // Ring of undo records, oldest at `first`
+    unsigned int first{};
+    unsigned int count{};
+
+    std::vector<uint64_t> pool; // Ring of 8-byte slots, allocated in record order
+    size_t slotsUsed{};
+
+    std::vector<uint8_t> latest; // Full snapshot of the latest checkpoint
+    std::vector<uint8_t> next;   // Scratch snapshot of the checkpoint being recorded
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "RomArchive.hpp"
+#include "ByteOrder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const uint8_t ROM_ARCHIVE_MAGIC[4] = {'C', '8', 'R', 'A'};
+}
+
+bool WriteRomArchive(char const* filename, std::vector<RomArchiveEntry> const& entries)
+{
+    // Entries in hash order (then name order, so equal ROMs are written deterministically)
+    std::vector<uint64_t> hashes(entries.size());
+    std::vector<uint32_t> order(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].data.size() > MAX_ROM_SIZE || entries[i].name.size() > 0xFFFFu)
+            return false;
+
+        hashes[i] = HashRom(entries[i].data.data(), entries[i].data.size());
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : entries[a].name < entries[b].name;
+    });
+
+    std::vector<uint32_t> byName(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        byName[i] = static_cast<uint32_t>(i);
+    std::sort(byName.begin(), byName.end(), [&](uint32_t a, uint32_t b)
+    {
+        return entries[order[a]].name < entries[order[b]].name;
+    });
+
+    // Lay out the names and the ROM data, storing identical ROMs once
+    std::vector<uint8_t> names;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> nameOffsets(order.size());
+    std::vector<uint32_t> dataOffsets(order.size());
+    std::map<std::vector<uint8_t>, uint32_t> stored;
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        RomArchiveEntry const& entry = entries[order[i]];
+
+        nameOffsets[i] = static_cast<uint32_t>(names.size());
+        names.insert(names.end(), entry.name.begin(), entry.name.end());
+
+        auto existing = stored.find(entry.data);
+        if (existing != stored.end())
+        {
+            dataOffsets[i] = existing->second;
+        }
+        else
+        {
+            dataOffsets[i] = static_cast<uint32_t>(data.size());
+            stored.emplace(entry.data, dataOffsets[i]);
+            data.insert(data.end(), entry.data.begin(), entry.data.end());
+        }
+    }
+
+    size_t count = order.size();
+    size_t nameIndexOffset = ROM_ARCHIVE_HEADER_SIZE + count * ROM_ARCHIVE_ENTRY_SIZE;
+    size_t namesOffset = nameIndexOffset + count * 4;
+    size_t dataOffset = namesOffset + names.size();
+
+    if (dataOffset + data.size() > 0xFFFFFFFFu)
+        return false;
+
+    std::vector<uint8_t> buffer(namesOffset);
+
+    memcpy(buffer.data(), ROM_ARCHIVE_MAGIC, 4);
+    Put16(&buffer[4], ROM_ARCHIVE_VERSION);
+    Put16(&buffer[6], 0);
+    Put32(&buffer[8], static_cast<uint32_t>(count));
+    Put32(&buffer[12], static_cast<uint32_t>(nameIndexOffset));
+    Put32(&buffer[16], static_cast<uint32_t>(namesOffset));
+    Put32(&buffer[20], static_cast<uint32_t>(dataOffset));
+    Put64(&buffer[24], 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        RomArchiveEntry const& entry = entries[order[i]];
+        uint8_t* out = &buffer[ROM_ARCHIVE_HEADER_SIZE + i * ROM_ARCHIVE_ENTRY_SIZE];
+
+        Put64(out, hashes[order[i]]);
+        Put32(out + 8, dataOffsets[i]);
+        Put16(out + 12, static_cast<uint16_t>(entry.data.size()));
+        out[14] = entry.hasQuirks ? static_cast<uint8_t>(entry.quirks) : ROM_ARCHIVE_NO_QUIRKS;
+        out[15] = 0;
+        Put16(out + 16, static_cast<uint16_t>(std::min(entry.cyclesPerFrame, 0xFFFFu)));
+        Put16(out + 18, static_cast<uint16_t>(entry.name.size()));
+        Put32(out + 20, nameOffsets[i]);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        Put32(&buffer[nameIndexOffset + 4 * i], byName[i]);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+    file.write(reinterpret_cast<char const*>(names.data()), names.size());
+    file.write(reinterpret_cast<char const*>(data.data()), data.size());
+
+    return static_cast<bool>(file);
+}
+
+RomArchive::~RomArchive()
+{
+    if (base)
+        munmap(const_cast<uint8_t*>(base), length);
+}
+
+bool RomArchive::Open(char const* filename)
+{
+    if (base)
+        return false;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || static_cast<size_t>(info.st_size) < ROM_ARCHIVE_HEADER_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (address == MAP_FAILED)
+        return false;
+
+    uint8_t const* file = static_cast<uint8_t const*>(address);
+
+    // Check every offset once here, so lookups can trust the archive
+    uint32_t entries = Get32(file + 8);
+    uint32_t nameIndexOffset = Get32(file + 12);
+    uint32_t namesOffset = Get32(file + 16);
+    uint32_t dataOffset = Get32(file + 20);
+
+    bool valid = memcmp(file, ROM_ARCHIVE_MAGIC, 4) == 0 && Get16(file + 4) == ROM_ARCHIVE_VERSION &&
+                 nameIndexOffset == ROM_ARCHIVE_HEADER_SIZE + uint64_t(entries) * ROM_ARCHIVE_ENTRY_SIZE &&
+                 namesOffset == nameIndexOffset + uint64_t(entries) * 4 &&
+                 namesOffset <= dataOffset && dataOffset <= size;
+
+    for (uint32_t i = 0; valid && i < entries; ++i)
+    {
+        uint8_t const* entry = file + ROM_ARCHIVE_HEADER_SIZE + i * ROM_ARCHIVE_ENTRY_SIZE;
+        uint64_t romEnd = uint64_t(dataOffset) + Get32(entry + 8) + Get16(entry + 12);
+        uint64_t nameEnd = uint64_t(namesOffset) + Get32(entry + 20) + Get16(entry + 18);
+        uint8_t quirks = entry[14];
+
+        valid = Get16(entry + 12) <= MAX_ROM_SIZE && romEnd <= size && nameEnd <= dataOffset &&
+                (quirks == ROM_ARCHIVE_NO_QUIRKS || quirks <= static_cast<uint8_t>(QuirkProfile::XoChip)) &&
+                Get32(file + nameIndexOffset + 4 * i) < entries;
+    }
+
+    if (!valid)
+    {
+        munmap(address, size);
+        return false;
+    }
+
+    base = file;
+    length = size;
+    count = entries;
+    nameIndex = file + nameIndexOffset;
+    names = file + namesOffset;
+    data = file + dataOffset;
+
+    return true;
+}
+
+RomImage RomArchive::Image(unsigned int i) const
+{
+    uint8_t const* entry = EntryAt(i);
+
+    RomImage image;
+    image.name = NameOf(entry);
+    image.size = Get16(entry + 12);
+    image.data = image.size ? data + Get32(entry + 8) : nullptr;
+    image.hash = Get64(entry);
+    image.hasQuirks = entry[14] != ROM_ARCHIVE_NO_QUIRKS;
+    image.quirks = image.hasQuirks ? static_cast<QuirkProfile>(entry[14]) : QuirkProfile::Default;
+    image.cyclesPerFrame = Get16(entry + 16);
+
+    return image;
+}
+
+bool RomArchive::FindByHash(uint64_t hash, RomImage& image) const
+{
+    // First entry with an equal or greater hash
+    unsigned int first = 0;
+    unsigned int last = count;
+    while (first < last)
+    {
+        unsigned int middle = first + (last - first) / 2;
+        if (Get64(EntryAt(middle)) < hash)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    if (first == count || Get64(EntryAt(first)) != hash)
+        return false;
+
+    image = Image(first);
+    return true;
+}
+
+bool RomArchive::FindByName(std::string const& name, RomImage& image) const
+{
+    unsigned int first = 0;
+    unsigned int last = count;
+    while (first < last)
+    {
+        unsigned int middle = first + (last - first) / 2;
+        if (NameOf(EntryAt(Get32(nameIndex + 4 * middle))) < name)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    if (first == count)
+        return false;
+
+    unsigned int i = Get32(nameIndex + 4 * first);
+    if (NameOf(EntryAt(i)) != name)
+        return false;
+
+    image = Image(i);
+    return true;
+}
+
+std::string RomArchive::NameOf(uint8_t const* entry) const
+{
+    return std::string(reinterpret_cast<char const*>(names + Get32(entry + 20)), Get16(entry + 18));
+}
@@ -0,0 +1,91 @@
+#ifndef ROMARCHIVE_H
+#define ROMARCHIVE_H
+
+#include "Chip8.hpp"
+#include "RomStore.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ROM archive format: a corpus of ROMs in one file, in a fixed little-endian layout that is
+// read in place from a read-only mapping.
+//
+//   offset  size  field
+//        0     4  magic "C8RA"
+//        4     2  version
+//        6     2  reserved (0)
+//        8     4  number of ROMs (N)
+//       12     4  offset of the name index
+//       16     4  offset of the names
+//       20     4  offset of the ROM data
+//       24     8  reserved (0)
+//       32  N*24  entries, sorted by hash (then name):
+//                    0  8  hash (FNV-1a of the ROM bytes, see HashRom)
+//                    8  4  offset of the ROM bytes (from the start of the ROM data)
+//                   12  2  ROM size
+//                   14  1  quirk profile (QuirkProfile value, 0xFF = not specified)
+//                   15  1  reserved (0)
+//                   16  2  cycles per frame (0 = not specified)
+//                   18  2  name length
+//                   20  4  offset of the name (from the start of the names, not terminated)
+//               N*4   name index: entry numbers sorted by name
+//                     names
+//                     ROM data (identical ROMs are stored once)
+const uint16_t ROM_ARCHIVE_VERSION = 1;
+const size_t ROM_ARCHIVE_HEADER_SIZE = 32;
+const size_t ROM_ARCHIVE_ENTRY_SIZE = 24;
+const uint8_t ROM_ARCHIVE_NO_QUIRKS = 0xFF;
+
+// A ROM to be written into an archive
+struct RomArchiveEntry
+{
+    std::string name;
+    std::vector<uint8_t> data;     // At most MAX_ROM_SIZE bytes
+    bool hasQuirks{};              // Whether quirks is specified
+    QuirkProfile quirks{QuirkProfile::Default};
+    unsigned int cyclesPerFrame{}; // 0 = not specified
+};
+
+// Writes entries as an archive. Returns false when a ROM is too big, a name is too long
+// or the file cannot be written.
+bool WriteRomArchive(char const* filename, std::vector<RomArchiveEntry> const& entries);
+
+// Read-only view of an archive file. The file is mapped once and validated when opened;
+// after that iterating, looking up ROMs and loading them never touches the file system.
+class RomArchive
+{
+public:
+    RomArchive() = default;
+    ~RomArchive();
+
+    RomArchive(RomArchive const&) = delete;
+    RomArchive& operator=(RomArchive const&) = delete;
+
+    // Maps and validates an archive. Returns false (leaving the archive closed) when the
+    // file cannot be mapped or is not a valid archive of this version.
+    bool Open(char const* filename);
+
+    // Number of ROMs
+    unsigned int Count() const { return count; }
+
+    // The i-th ROM in hash order, i < Count(). The image's data points into the mapping.
+    RomImage Image(unsigned int i) const;
+
+    // Binary searches for a ROM by content hash or by name. Returns false when there is none.
+    bool FindByHash(uint64_t hash, RomImage& image) const;
+    bool FindByName(std::string const& name, RomImage& image) const;
+
+private:
+    uint8_t const* EntryAt(unsigned int i) const { return base + ROM_ARCHIVE_HEADER_SIZE + i * ROM_ARCHIVE_ENTRY_SIZE; }
+    std::string NameOf(uint8_t const* entry) const;
+
+    uint8_t const* base{}; // Start of the mapping
+    size_t length{};       // Size of the mapping
+    unsigned int count{};
+    uint8_t const* nameIndex{};
+    uint8_t const* names{};
+    uint8_t const* data{};
+};
+
+#endif
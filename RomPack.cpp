@@ -0,0 +1,132 @@
+// Builds and lists ROM archives (see RomArchive.hpp).
+//
+//   chip8pack [--quirks <profile>] [--ipf <N>] <archive> <ROM or directory>...
+//   chip8pack --list <archive>
+//
+// --quirks and --ipf apply to the ROMs that follow them (until the next --quirks/--ipf;
+// "--quirks none" and "--ipf 0" go back to not specifying them).
+
+#include "RomArchive.hpp"
+#include "RomStore.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void PrintUsage(char const* program)
+{
+    std::cerr << "Usage: " << program << " [--quirks <profile>] [--ipf <N>] <archive> <ROM or directory>...\n"
+              << "       " << program << " --list <archive>\n";
+}
+
+static int ListArchive(char const* filename)
+{
+    RomArchive archive;
+    if (!archive.Open(filename))
+    {
+        std::cerr << "Not a ROM archive: " << filename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    for (unsigned int i = 0; i < archive.Count(); ++i)
+    {
+        RomImage rom = archive.Image(i);
+
+        std::cout << std::hex << std::setw(16) << std::setfill('0') << rom.hash << std::dec << std::setfill(' ')
+                  << ' ' << std::setw(5) << rom.size
+                  << " quirks=" << (rom.hasQuirks ? QuirkProfileName(rom.quirks) : "-")
+                  << " ipf=" << rom.cyclesPerFrame
+                  << ' ' << rom.name << '\n';
+    }
+
+    std::cout << "ROMs: " << archive.Count() << '\n';
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && std::strcmp(argv[1], "--list") == 0)
+        return ListArchive(argv[2]);
+
+    char const* archiveFilename = nullptr;
+    std::vector<RomArchiveEntry> entries;
+    RomArchiveEntry settings; // Metadata for the ROMs that follow
+    RomStore store;
+    bool failed = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            char const* name = argv[++i];
+            settings.hasQuirks = std::strcmp(name, "none") != 0;
+            if (settings.hasQuirks && !ParseQuirkProfile(name, settings.quirks))
+            {
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+        {
+            int cycles = std::stoi(argv[++i]);
+            if (cycles < 0 || cycles > 0xFFFF)
+            {
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            settings.cyclesPerFrame = cycles;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else if (!archiveFilename)
+        {
+            archiveFilename = argv[i];
+        }
+        else
+        {
+            // A directory stands for the files in it
+            std::vector<std::string> names;
+            if (!store.AddDirectory(argv[i], names))
+            {
+                store.AddFile(argv[i]);
+                names.push_back(argv[i]);
+            }
+
+            for (std::string const& name : names)
+            {
+                RomImage const* rom = store.Find(name);
+                if (!rom)
+                {
+                    std::cerr << "Could not add ROM: " << name << '\n';
+                    failed = true;
+                    continue;
+                }
+
+                RomArchiveEntry entry = settings;
+                entry.name = name;
+                entry.data.assign(rom->data, rom->data + rom->size);
+                entries.push_back(entry);
+            }
+        }
+    }
+
+    if (!archiveFilename)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!WriteRomArchive(archiveFilename, entries))
+    {
+        std::cerr << "Could not write archive: " << archiveFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "ROMs: " << entries.size() << '\n';
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include "RomStore.hpp"
+#include "RomArchive.hpp"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t HashRom(uint8_t const* data, size_t size)
+{
+    Fnv1a hash;
+    hash.Add(data, size);
+    return hash.Value();
+}
+
+RomStore::RomStore() = default;
+
+RomStore::~RomStore()
+{
+    for (Mapping const& mapping : mappings)
+        munmap(mapping.address, mapping.length);
+}
+
+RomImage const* RomStore::AddFile(std::string const& path)
+{
+    auto existing = images.find(path);
+    if (existing != images.end())
+        return &existing->second;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || static_cast<size_t>(info.st_size) > MAX_ROM_SIZE)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    RomImage image;
+    image.name = path;
+    image.size = static_cast<size_t>(info.st_size);
+
+    // An empty file cannot be mapped, but is a valid (empty) ROM
+    if (image.size > 0)
+    {
+        void* address = mmap(nullptr, image.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        mappings.push_back(Mapping{address, image.size});
+        image.data = static_cast<uint8_t const*>(address);
+    }
+
+    // The mapping outlives the descriptor
+    close(fd);
+
+    image.hash = HashRom(image.data, image.size);
+
+    return &images.emplace(path, image).first->second;
+}
+
+bool RomStore::AddDirectory(std::string const& path, std::vector<std::string>& names)
+{
+    DIR* directory = opendir(path.c_str());
+    if (!directory)
+        return false;
+
+    // Regular files only, subdirectories are not searched
+    std::vector<std::string> entries;
+    while (dirent* entry = readdir(directory))
+    {
+        std::string name = path + '/' + entry->d_name;
+
+        struct stat info;
+        if (entry->d_name[0] != '.' && stat(name.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            entries.push_back(name);
+    }
+    closedir(directory);
+
+    std::sort(entries.begin(), entries.end());
+
+    for (std::string const& entry : entries)
+    {
+        AddFile(entry);
+        names.push_back(entry);
+    }
+
+    return true;
+}
+
+bool RomStore::AddArchive(std::string const& path, std::vector<std::string>& names)
+{
+    std::unique_ptr<RomArchive> archive(new RomArchive);
+    if (!archive->Open(path.c_str()))
+        return false;
+
+    std::vector<std::string> added;
+    for (unsigned int i = 0; i < archive->Count(); ++i)
+    {
+        RomImage image = archive->Image(i);
+        if (images.emplace(image.name, image).second)
+            added.push_back(image.name);
+    }
+
+    std::sort(added.begin(), added.end());
+    names.insert(names.end(), added.begin(), added.end());
+
+    archives.push_back(std::move(archive));
+    return true;
+}
+
+RomImage const* RomStore::Find(std::string const& name) const
+{
+    auto image = images.find(name);
+    return image != images.end() ? &image->second : nullptr;
+}
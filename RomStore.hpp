@@ -0,0 +1,108 @@
+#ifndef ROMSTORE_H
+#define ROMSTORE_H
+
+#include "Chip8.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RomArchive;
+
+// A ROM mapped into memory. data stays valid for the lifetime of the RomStore (or RomArchive).
+struct RomImage
+{
+    std::string name;          // Path the ROM was added by (or its name in an archive)
+    uint8_t const* data{};     // Read-only mapping of the ROM bytes (nullptr for an empty ROM)
+    size_t size{};             // Size in bytes, at most MAX_ROM_SIZE
+    uint64_t hash{};           // FNV-1a hash of the ROM bytes
+
+    // Metadata (archives only)
+    bool hasQuirks{};              // Whether quirks is specified
+    QuirkProfile quirks{QuirkProfile::Default};
+    unsigned int cyclesPerFrame{}; // Suggested speed, 0 = not specified
+};
+
+// FNV-1a: the hash of ROMs, video and machine states (HashVideo, HashState) and audio
+// (AudioStream). Value() is the hash of every byte added so far; a hash can be continued
+// from the Value() of another.
+class Fnv1a
+{
+public:
+    static const uint64_t OFFSET_BASIS = 14695981039346656037ull;
+    static const uint64_t PRIME = 1099511628211ull;
+
+    explicit Fnv1a(uint64_t hash = OFFSET_BASIS) : hash(hash) {}
+
+    void Add(uint8_t byte) { hash = (hash ^ byte) * PRIME; }
+
+    // Low byte first
+    void Add16(uint16_t value)
+    {
+        Add(value & 0xFFu);
+        Add(value >> 8u);
+    }
+
+    void Add(uint8_t const* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            Add(data[i]);
+    }
+
+    uint64_t Value() const { return hash; }
+
+private:
+    uint64_t hash;
+};
+
+// FNV-1a hash of ROM bytes (RomImage::hash)
+uint64_t HashRom(uint8_t const* data, size_t size);
+
+// Read-only store of memory-mapped ROMs, shared by any number of machines.
+// Every file is mapped once, validated against the space available above START_ADDRESS
+// and hashed; machines then initialize their memory with a single bulk copy from the
+// mapping (Chip8::LoadROM(data, size)). Adding ROMs is not thread-safe, looking them up is.
+class RomStore
+{
+public:
+    RomStore();
+    ~RomStore();
+
+    RomStore(RomStore const&) = delete;
+    RomStore& operator=(RomStore const&) = delete;
+
+    // Maps a ROM file. Returns nullptr when the file cannot be opened or mapped, or is too big
+    // to load. Adding a path that is already in the store returns the existing image.
+    RomImage const* AddFile(std::string const& path);
+
+    // Maps every regular file of a directory. The names of the files, sorted, are appended
+    // to names (the ones that could not be mapped are not in the store, see Find).
+    // Returns false when the directory cannot be read.
+    bool AddDirectory(std::string const& path, std::vector<std::string>& names);
+
+    // Maps a ROM archive (see RomArchive.hpp) and adds all of its ROMs, which share the one
+    // mapping. The names of the ROMs, sorted, are appended to names; ROMs with a name already
+    // in the store are skipped. Returns false when the file is not a valid archive.
+    bool AddArchive(std::string const& path, std::vector<std::string>& names);
+
+    // The ROM added by name, or nullptr
+    RomImage const* Find(std::string const& name) const;
+
+    // Number of ROMs in the store
+    size_t Count() const { return images.size(); }
+
+private:
+    struct Mapping
+    {
+        void* address;
+        size_t length;
+    };
+
+    std::vector<Mapping> mappings;
+    std::vector<std::unique_ptr<RomArchive>> archives;
+    std::map<std::string, RomImage> images; // Node based, so image pointers stay valid
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "Runner.hpp"
+#include "Analyzer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // Job queue of one worker, the owner pops from the front and thieves from the back
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+
+        bool PopFront(size_t& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty())
+                return false;
+            job = jobs.front();
+            jobs.pop_front();
+            return true;
+        }
+
+        bool PopBack(size_t& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty())
+                return false;
+            job = jobs.back();
+            jobs.pop_back();
+            return true;
+        }
+    };
+
+    void RunJob(RunnerJob const& job, RomImage const* rom, RunnerOptions const& options, RunnerResult& result)
+    {
+        if (!rom)
+            return;
+
+        // Settings stored with the ROM (in an archive) take precedence over the batch's
+        QuirkProfile quirks = rom->hasQuirks ? rom->quirks : options.quirks;
+        unsigned int cyclesPerFrame = rom->cyclesPerFrame ? rom->cyclesPerFrame : options.cyclesPerFrame;
+
+        // Machines are too big for comfortable stack use on worker threads
+        std::unique_ptr<Chip8> chip8(new Chip8(quirks));
+        SeedRandom(chip8->randGen, job.seed);
+
+        result.loaded = chip8->LoadROM(rom->data, rom->size);
+        if (!result.loaded)
+            return;
+
+        if (options.staticAnalysis)
+            UseStaticAnalysis(*chip8);
+
+        if (!options.checkpointFrames)
+        {
+            result.run = RunHeadless(*chip8, job.maxCycles, cyclesPerFrame, options.engine, options.skipIdle);
+            result.videoHash = HashVideo(*chip8);
+            return;
+        }
+
+        // Whole frames between checkpoints, so every chunk starts on a frame boundary
+        uint64_t interval = uint64_t(options.checkpointFrames) * cyclesPerFrame;
+
+        while (true)
+        {
+            uint64_t budget = std::min(interval, job.maxCycles - result.run.cycles);
+            HeadlessResult chunk = RunHeadless(*chip8, budget, cyclesPerFrame, options.engine, options.skipIdle);
+
+            result.run.cycles += chunk.cycles;
+            result.run.seconds += chunk.seconds;
+            result.run.idleCycles += chunk.idleCycles;
+            result.run.reason = chunk.reason;
+            result.checkpoints.push_back(options.checkpointState ? HashState(*chip8) : HashVideo(*chip8));
+
+            if (chunk.reason != HaltReason::CycleLimit || result.run.cycles == job.maxCycles)
+                break;
+        }
+
+        result.videoHash = HashVideo(*chip8);
+    }
+}
+
+RunnerStats RunBatch(std::vector<RunnerJob> const& jobs, RunnerOptions const& options,
+                     std::vector<RunnerResult>& results, RomStore* store)
+{
+    RunnerStats stats;
+
+    // Map every ROM once, before the workers start (the store is read-only from then on)
+    RomStore localStore;
+    if (!store)
+        store = &localStore;
+
+    std::vector<RomImage const*> roms(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i)
+        roms[i] = store->AddFile(jobs[i].romFilename);
+
+    unsigned int threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    if (threads > jobs.size())
+        threads = jobs.empty() ? 1 : static_cast<unsigned int>(jobs.size());
+    stats.threads = threads;
+
+    results.assign(jobs.size(), RunnerResult());
+
+    // Deal the jobs round-robin so every worker starts with a similar mix
+    std::vector<WorkerQueue> queues(threads);
+    for (size_t i = 0; i < jobs.size(); ++i)
+        queues[i % threads].jobs.push_back(i);
+
+    std::vector<uint64_t> steals(threads);
+
+    auto worker = [&](unsigned int self)
+    {
+        size_t job;
+
+        while (true)
+        {
+            if (!queues[self].PopFront(job))
+            {
+                // Own queue drained, look for work in the others
+                bool stolen = false;
+                for (unsigned int i = 1; i < threads && !stolen; ++i)
+                    stolen = queues[(self + i) % threads].PopBack(job);
+
+                // Jobs are never added once the batch started, so no work is left anywhere
+                if (!stolen)
+                    break;
+
+                ++steals[self];
+            }
+
+            results[job].worker = self;
+            RunJob(jobs[job], roms[job], options, results[job]);
+        }
+    };
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; ++i)
+        pool.emplace_back(worker, i);
+
+    // The calling thread is worker 0
+    worker(0);
+
+    for (std::thread& thread : pool)
+        thread.join();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    for (RunnerResult const& result : results)
+        stats.totalCycles += result.run.cycles;
+    for (uint64_t count : steals)
+        stats.steals += count;
+
+    return stats;
+}
+
+uint64_t HashVideo(Chip8 const& chip8)
+{
+    Fnv1a hash;
+
+    // The rows of the current display mode; the second plane only counts once something was
+    // drawn on it, so single plane screens hash the same as they always did
+    unsigned int words = chip8.VideoHeight() * chip8.RowWords();
+
+    for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+    {
+        uint64_t const* screen = &chip8.video[plane * VIDEO_PLANE_WORDS];
+
+        if (plane > 0 && std::all_of(screen, screen + words, [](uint64_t word) { return word == 0; }))
+            continue;
+
+        for (unsigned int i = 0; i < words; ++i)
+        {
+            for (unsigned int shift = 64; shift > 0; shift -= 8)
+                hash.Add((screen[i] >> (shift - 8)) & 0xFFu);
+        }
+    }
+
+    return hash.Value();
+}
+
+uint64_t HashState(Chip8 const& chip8)
+{
+    Fnv1a hash(HashVideo(chip8));
+
+    hash.Add(chip8.registers, sizeof(chip8.registers));
+    for (uint16_t address : chip8.stack)
+        hash.Add16(address);
+
+    hash.Add16(chip8.index);
+    hash.Add16(chip8.pc);
+    hash.Add(chip8.sp);
+    hash.Add(chip8.delayTimer);
+    hash.Add(chip8.soundTimer);
+    hash.Add(chip8.hires);
+    hash.Add(chip8.planes);
+
+    hash.Add(chip8.memory, MEMORY_SIZE);
+
+    return hash.Value();
+}
@@ -0,0 +1,66 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include "Chip8.hpp"
+#include "Headless.hpp"
+#include "RomStore.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One independent machine of a batch run
+struct RunnerJob
+{
+    std::string romFilename;
+    uint64_t seed{};      // Seed of the machine's random number generator
+    uint64_t maxCycles{}; // Cycle budget of the headless run
+};
+
+// Outcome of one machine of a batch run
+struct RunnerResult
+{
+    bool loaded{};          // false if the ROM could not be opened
+    HeadlessResult run;     // Valid when loaded
+    uint64_t videoHash{};   // FNV-1a hash of the final video memory
+    std::vector<uint64_t> checkpoints; // Hashes taken every RunnerOptions::checkpointFrames frames
+    unsigned int worker{};  // Index of the worker thread that ran the job
+};
+
+// Settings shared by every machine of a batch run
+struct RunnerOptions
+{
+    unsigned int threads{};  // 0 = one worker per hardware thread
+    unsigned int cyclesPerFrame{DEFAULT_CYCLES_PER_FRAME};
+    Engine engine{Engine::Interpreter};
+    QuirkProfile quirks{QuirkProfile::Default};
+    unsigned int checkpointFrames{}; // Hash the machine every N frames and at the end (0 = never)
+    bool checkpointState{};          // Checkpoints hash the whole state (HashState), not only video
+    bool staticAnalysis{};           // Analyze each loaded program for the engines (UseStaticAnalysis)
+    bool skipIdle{};                 // Skip the passes of busy-wait loops (IdleDetector)
+};
+
+// Aggregated outcome of a batch run
+struct RunnerStats
+{
+    unsigned int threads{};   // Number of worker threads used
+    uint64_t totalCycles{};   // Instructions executed by all machines
+    double seconds{};         // Wall-clock time of the whole batch
+    uint64_t steals{};        // Jobs taken from another worker's queue
+};
+
+// Runs every job headless on its own Chip8 instance, spread over a pool of worker
+// threads. Jobs are dealt round-robin to per-worker queues; a worker that runs out
+// of work steals from the back of the other queues. results[i] belongs to jobs[i].
+// Every distinct ROM file is mapped once into store (a temporary store when nullptr, ROMs
+// already in it, e.g. from archives, are reused) and the machines load it from the shared
+// mapping. A ROM's own quirk profile and speed (see RomImage) override the options.
+RunnerStats RunBatch(std::vector<RunnerJob> const& jobs, RunnerOptions const& options,
+                     std::vector<RunnerResult>& results, RomStore* store = nullptr);
+
+// FNV-1a hash of the video memory (the rows of the current display mode)
+uint64_t HashVideo(Chip8 const& chip8);
+
+// FNV-1a hash of the registers, stack, timers, display mode, memory and video (HashVideo)
+uint64_t HashState(Chip8 const& chip8);
+
+#endif
@@ -0,0 +1,64 @@
+#include "Scheduler.hpp"
+#include "Profile.hpp"
+#include <cmath>
+#include <thread>
+
+// Number of late frames after which the scheduler gives up catching up
+const unsigned int MAX_FRAME_LAG = 4;
+
+unsigned int CyclesPerFrameFromDelay(int cycleDelay)
+{
+    // No delay used to mean "as fast as the loop spins", fall back to the default speed
+    if (cycleDelay <= 0)
+        return DEFAULT_CYCLES_PER_FRAME;
+
+    long cycles = std::lround(1000.0 / (TIMER_FREQUENCY * cycleDelay));
+    return cycles > 0 ? static_cast<unsigned int>(cycles) : 1;
+}
+
+FrameScheduler::FrameScheduler(unsigned int cyclesPerFrame, unsigned int frameRate, Engine engine, bool skipIdle)
+    : cyclesPerFrame(cyclesPerFrame),
+      engine(engine),
+      skipIdle(skipIdle),
+      framePeriod(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRate))),
+      nextFrame(Clock::now())
+{
+}
+
+void FrameScheduler::RunFrame(Chip8& chip8)
+{
+    // The keypad may have changed (or the machine been rewound) since the last frame
+    idle.Reset();
+
+    // CPU budget of this frame
+    for (unsigned int i = 0; i < cyclesPerFrame; )
+    {
+        uint16_t pc = chip8.pc;
+        unsigned int executed = chip8.Step(engine, cyclesPerFrame - i);
+        if (skipIdle)
+            executed += idle.Skip(chip8, pc, executed, cyclesPerFrame - i - executed);
+        i += executed;
+    }
+
+    // Timers always run at exactly one tick per frame
+    chip8.TickTimers();
+    CHIP8_PROFILE_END_FRAME(chip8.profile);
+}
+
+void FrameScheduler::WaitForNextFrame()
+{
+    nextFrame += framePeriod;
+
+    Clock::time_point now = Clock::now();
+
+    if (now < nextFrame)
+    {
+        // Sleep instead of spinning on the clock
+        std::this_thread::sleep_until(nextFrame);
+    }
+    else if (now - nextFrame > framePeriod * MAX_FRAME_LAG)
+    {
+        // Too far behind (e.g. the window was dragged), restart pacing from now
+        nextFrame = now;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Chip8.hpp"
+#include "Idle.hpp"
+#include <chrono>
+
+// Instructions executed per 60 Hz frame when nothing else is requested (~600 Hz CPU)
+const unsigned int DEFAULT_CYCLES_PER_FRAME = 10;
+
+// Converts the old per-instruction delay (in milliseconds) into an instruction budget per frame
+unsigned int CyclesPerFrameFromDelay(int cycleDelay);
+
+// Paces emulation in fixed frames: a CPU budget of cyclesPerFrame instructions,
+// one timer tick and (at most) one present per frame, sleeping in between
+class FrameScheduler
+{
+public:
+    // With skipIdle the passes of busy-wait loops are skipped up to the end of the frame
+    explicit FrameScheduler(unsigned int cyclesPerFrame, unsigned int frameRate = TIMER_FREQUENCY,
+                            Engine engine = Engine::Interpreter, bool skipIdle = false);
+
+    // Executes one frame worth of instructions and ticks the timers once
+    void RunFrame(Chip8& chip8);
+
+    // Sleeps until the next frame is due
+    void WaitForNextFrame();
+
+    unsigned int CyclesPerFrame() const { return cyclesPerFrame; }
+
+    // Instructions of idle loops counted as executed without running them
+    uint64_t IdleCycles() const { return idle.Skipped(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    unsigned int cyclesPerFrame;
+    Engine engine;
+    bool skipIdle;
+    IdleDetector idle;
+    Clock::duration framePeriod;
+    Clock::time_point nextFrame;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "Snapshot.hpp"
+#include "ByteOrder.hpp"
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const uint8_t SNAPSHOT_MAGIC[4] = {'C', '8', 'S', 'N'};
+
+    // The state of a multiplicative LCG is the last value it returned, which is recovered
+    // from the next value with the modular inverse of the multiplier
+    static_assert(RandomEngine::multiplier == 48271 && RandomEngine::increment == 0 &&
+                  RandomEngine::modulus == 2147483647, "RandomState assumes std::minstd_rand");
+    const uint64_t MULTIPLIER_INVERSE = 1899818559; // 48271 * 1899818559 = 1 (mod 2^31 - 1)
+
+    // Whether buffer holds a state that chip8 can be in: taken with the same quirk profile,
+    // and nothing that profile cannot reach
+    bool FitsMachine(Chip8 const& chip8, uint8_t const* buffer)
+    {
+        if (buffer[6] != static_cast<uint8_t>(chip8.quirks))
+            return false;
+
+        // Fx55/Fx65 reach I + 15, Dxyn I + 14 and Fx33 I + 2 without wrapping around memory
+        if (Get16(buffer + 56) > MEMORY_SIZE - 16)
+            return false;
+
+        // The stack holds 16 return addresses
+        if (buffer[60] > 16)
+            return false;
+
+        uint8_t hires = buffer[63];
+        if (hires & ~1u || (hires && !chip8.HasExtendedDisplay()))
+            return false;
+
+        // Only XO-CHIP selects planes (Fn01), every other profile draws on plane 0 alone
+        uint8_t planes = buffer[84];
+        if (planes & ~0x3u || (chip8.quirks != QuirkProfile::XoChip && planes != 1))
+            return false;
+
+        // A state the engine reaches: 1 to modulus - 1
+        uint32_t random = Get32(buffer + 80);
+        return random != 0 && random < RandomEngine::modulus;
+    }
+
+    // Granularity of the memory comparison on restore
+    const unsigned int RESTORE_CHUNK = MEMORY_PAGE_SIZE;
+}
+
+uint32_t RandomState(RandomEngine engine)
+{
+    uint64_t next = engine();
+    return static_cast<uint32_t>(next * MULTIPLIER_INVERSE % RandomEngine::modulus);
+}
+
+size_t SaveSnapshot(Chip8 const& chip8, uint8_t* buffer, size_t size)
+{
+    if (size < SNAPSHOT_SIZE)
+        return 0;
+
+    memcpy(buffer, SNAPSHOT_MAGIC, 4);
+    Put16(buffer + 4, SNAPSHOT_VERSION);
+    buffer[6] = static_cast<uint8_t>(chip8.quirks);
+    buffer[7] = 0;
+
+    memcpy(buffer + 8, chip8.registers, 16);
+    for (unsigned int i = 0; i < 16; ++i)
+        Put16(buffer + 24 + 2 * i, chip8.stack[i]);
+
+    Put16(buffer + 56, chip8.index);
+    Put16(buffer + 58, chip8.pc);
+    buffer[60] = chip8.sp;
+    buffer[61] = chip8.delayTimer;
+    buffer[62] = chip8.soundTimer;
+    buffer[63] = chip8.hires ? 1 : 0;
+
+    for (unsigned int key = 0; key < 16; ++key)
+        buffer[64 + key] = chip8.KeyDown(key) ? 1 : 0;
+    Put32(buffer + 80, RandomState(chip8.randGen));
+    buffer[84] = chip8.planes;
+    buffer[85] = chip8.pitch;
+    Put16(buffer + 86, 0);
+    memcpy(buffer + 88, chip8.audioPattern, AUDIO_PATTERN_SIZE);
+
+    for (unsigned int i = 0; i < VIDEO_WORDS; ++i)
+        Put64(buffer + SNAPSHOT_VIDEO_OFFSET + 8 * i, chip8.video[i]);
+
+    memcpy(buffer + SNAPSHOT_MEMORY_OFFSET, chip8.memory, MEMORY_SIZE);
+
+    return SNAPSHOT_SIZE;
+}
+
+bool RestoreSnapshot(Chip8& chip8, uint8_t const* buffer, size_t size)
+{
+    if (size < SNAPSHOT_SIZE || memcmp(buffer, SNAPSHOT_MAGIC, 4) != 0 || Get16(buffer + 4) != SNAPSHOT_VERSION)
+        return false;
+
+    // Everything is checked before the first field of chip8 changes
+    if (!FitsMachine(chip8, buffer))
+        return false;
+
+    memcpy(chip8.registers, buffer + 8, 16);
+    for (unsigned int i = 0; i < 16; ++i)
+        chip8.stack[i] = Get16(buffer + 24 + 2 * i);
+
+    chip8.index = Get16(buffer + 56);
+    chip8.pc = Get16(buffer + 58);
+    chip8.sp = buffer[60];
+    chip8.delayTimer = buffer[61];
+    chip8.soundTimer = buffer[62];
+    chip8.hires = buffer[63] & 1u;
+
+    chip8.keypad = 0;
+    for (unsigned int key = 0; key < 16; ++key)
+        chip8.keypad |= (buffer[64 + key] & 1u) << key;
+    chip8.randGen.seed(Get32(buffer + 80));
+    chip8.planes = buffer[84];
+    chip8.pitch = buffer[85];
+    memcpy(chip8.audioPattern, buffer + 88, AUDIO_PATTERN_SIZE);
+
+    for (unsigned int i = 0; i < VIDEO_WORDS; ++i)
+        chip8.video[i] = Get64(buffer + SNAPSHOT_VIDEO_OFFSET + 8 * i);
+    chip8.MarkRowsDirty(0, chip8.VideoHeight() - 1);
+
+    // Rolling back usually only touches a few bytes of memory, so only copy (and drop the
+    // decoded instructions of) the chunks that actually changed
+    uint8_t const* memory = buffer + SNAPSHOT_MEMORY_OFFSET;
+    for (unsigned int chunk = 0; chunk < MEMORY_SIZE; chunk += RESTORE_CHUNK)
+    {
+        if (memcmp(&chip8.memory[chunk], &memory[chunk], RESTORE_CHUNK) != 0)
+        {
+            memcpy(&chip8.memory[chunk], &memory[chunk], RESTORE_CHUNK);
+            chip8.MemoryWritten(chunk, RESTORE_CHUNK);
+        }
+    }
+
+    return true;
+}
+
+bool WriteSnapshotFile(char const* filename, uint8_t const* buffer, size_t size)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    if (!file.is_open() || size < SNAPSHOT_SIZE)
+        return false;
+
+    file.write(reinterpret_cast<char const*>(buffer), SNAPSHOT_SIZE);
+    return static_cast<bool>(file);
+}
+
+bool ReadSnapshotFile(char const* filename, uint8_t* buffer, size_t size)
+{
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open() || size < SNAPSHOT_SIZE)
+        return false;
+
+    file.read(reinterpret_cast<char*>(buffer), SNAPSHOT_SIZE);
+    return file.gcount() == static_cast<std::streamsize>(SNAPSHOT_SIZE);
+}
@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "Chip8.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Snapshot format: the complete machine state in a fixed, little-endian byte layout.
+// The same bytes are used in memory and in snapshot files.
+//
+//   offset  size  field
+//        0     4  magic "C8SN"
+//        4     2  version
+//        6     1  quirk profile (QuirkProfile)
+//        7     1  reserved (0)
+//        8    16  registers V0-VF
+//       24    32  stack (16 x u16)
+//       56     2  index
+//       58     2  pc
+//       60     1  sp
+//       61     1  delay timer
+//       62     1  sound timer
+//       63     1  display mode (bit 0 = hi-res)
+//       64    16  keypad
+//       80     4  random number engine state
+//       84     1  selected planes
+//       85     1  audio pitch
+//       86     2  reserved (0)
+//       88    16  audio pattern
+//      104  2048  video (VIDEO_WORDS x u64, see VIDEO_PLANE_WORDS)
+//     2152  4096  memory
+const uint16_t SNAPSHOT_VERSION = 4;
+const size_t SNAPSHOT_VIDEO_OFFSET = 104;
+const size_t SNAPSHOT_MEMORY_OFFSET = SNAPSHOT_VIDEO_OFFSET + VIDEO_WORDS * sizeof(uint64_t);
+const size_t SNAPSHOT_SIZE = SNAPSHOT_MEMORY_OFFSET + MEMORY_SIZE;
+
+// The state word of a random number engine, as stored in snapshots (restored with seed())
+uint32_t RandomState(RandomEngine engine);
+
+// Writes the state of chip8 into buffer. Returns the number of bytes written
+// (SNAPSHOT_SIZE), or 0 if the buffer is too small. Never allocates.
+size_t SaveSnapshot(Chip8 const& chip8, uint8_t* buffer, size_t size);
+
+// Restores the state of chip8 from buffer. Returns false (leaving chip8 untouched) when the
+// buffer is too small, is not a snapshot of this version, was taken with another quirk profile
+// than chip8's or holds a state chip8 cannot be in (stack pointer past the stack, I so close to
+// the end of memory that Fx55 would run past it, display mode or planes its profile does not have). Never allocates; only the memory chunks that differ
+// from the current memory are copied and invalidated.
+bool RestoreSnapshot(Chip8& chip8, uint8_t const* buffer, size_t size);
+
+// Snapshot files contain exactly one snapshot
+bool WriteSnapshotFile(char const* filename, uint8_t const* buffer, size_t size);
+bool ReadSnapshotFile(char const* filename, uint8_t* buffer, size_t size);
+
+#endif
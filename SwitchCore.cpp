@@ -0,0 +1,379 @@
+// Second interpreter core: fetches from memory and decodes with a plain switch on every
+// instruction, written independently of the OP_* handlers, the function tables and the
+// decode cache. It keeps the simplest possible video code (one pixel at a time), so the
+// word-wide drawing and scrolling of the table driven engines can be checked against it
+// (see Differential.hpp). Behaviour that is specific to this emulator (e.g. Fx29 not
+// masking the digit) is mirrored on purpose; memory, stack and keypad
+// accesses wrap instead of running past the end of their arrays.
+
+#include "Chip8.hpp"
+#include "Profile.hpp"
+#include <cstring>
+
+namespace
+{
+    uint64_t& PixelWord(Chip8& chip8, unsigned int plane, unsigned int x, unsigned int y)
+    {
+        return chip8.video[plane * VIDEO_PLANE_WORDS + y * chip8.RowWords() + x / 64];
+    }
+
+    uint64_t PixelBit(unsigned int x)
+    {
+        return 1ull << (63u - x % 64u);
+    }
+
+    void SetPixel(Chip8& chip8, unsigned int plane, unsigned int x, unsigned int y, bool on)
+    {
+        if (on)
+            PixelWord(chip8, plane, x, y) |= PixelBit(x);
+        else
+            PixelWord(chip8, plane, x, y) &= ~PixelBit(x);
+    }
+
+    // Whether plane p is drawn, cleared and scrolled
+    bool Selected(Chip8 const& chip8, unsigned int plane)
+    {
+        return (chip8.planes >> plane) & 1u;
+    }
+
+    void ClearSelected(Chip8& chip8)
+    {
+        for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+        {
+            if (Selected(chip8, plane))
+                memset(&chip8.video[plane * VIDEO_PLANE_WORDS], 0, VIDEO_PLANE_WORDS * sizeof(uint64_t));
+        }
+    }
+
+    void SetMode(Chip8& chip8, bool hires)
+    {
+        memset(chip8.video, 0, sizeof(chip8.video));
+        chip8.hires = hires;
+    }
+
+    // Moves every pixel of the selected planes by (dx, dy), pixels moved in are off
+    void Scroll(Chip8& chip8, int dx, int dy)
+    {
+        int width = chip8.VideoWidth();
+        int height = chip8.VideoHeight();
+
+        for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+        {
+            if (!Selected(chip8, plane))
+                continue;
+
+            // Walk against the direction of the move, so sources are read before they are overwritten
+            for (int i = 0; i < height; ++i)
+            {
+                int y = dy > 0 ? height - 1 - i : i;
+
+                for (int j = 0; j < width; ++j)
+                {
+                    int x = dx > 0 ? width - 1 - j : j;
+                    int fromX = x - dx;
+                    int fromY = y - dy;
+
+                    bool on = fromX >= 0 && fromX < width && fromY >= 0 && fromY < height &&
+                              chip8.GetPixel(fromX, fromY, plane);
+                    SetPixel(chip8, plane, x, y, on);
+                }
+            }
+        }
+    }
+
+    // Dxyn on any profile: n rows of 8 pixels, or 16x16 for n = 0 on the extended profiles,
+    // one sprite per selected plane
+    void Draw(Chip8& chip8, unsigned int x, unsigned int y, unsigned int n, bool extended, bool clip)
+    {
+        unsigned int width = chip8.VideoWidth();
+        unsigned int height = chip8.VideoHeight();
+
+        unsigned int spriteWidth = extended && n == 0 ? 16 : 8;
+        unsigned int spriteHeight = extended && n == 0 ? 16 : n;
+        unsigned int startX = chip8.registers[x] % width;
+        unsigned int startY = chip8.registers[y] % height;
+
+        uint16_t address = chip8.index;
+        bool collision = false;
+
+        for (unsigned int plane = 0; plane < VIDEO_PLANES; ++plane)
+        {
+            if (!Selected(chip8, plane))
+                continue;
+
+            for (unsigned int row = 0; row < spriteHeight; ++row)
+            {
+                unsigned int py = startY + row;
+                if (py >= height && clip)
+                    break;
+
+                for (unsigned int column = 0; column < spriteWidth; ++column)
+                {
+                    uint8_t byte = chip8.memory[(address + row * (spriteWidth / 8) + column / 8) & 0x0FFFu];
+                    if (!((byte >> (7u - column % 8u)) & 1u))
+                        continue;
+
+                    unsigned int px = startX + column;
+                    if (px >= width && clip)
+                        break;
+
+                    uint64_t& word = PixelWord(chip8, plane, px % width, py % height);
+                    uint64_t bit = PixelBit(px % width);
+
+                    if (word & bit)
+                        collision = true;
+                    word ^= bit;
+                }
+            }
+
+            address += spriteHeight * (spriteWidth / 8);
+        }
+
+        chip8.registers[0xF] = collision ? 1 : 0;
+    }
+}
+
+template <typename Quirks>
+void Chip8::SwitchCycle()
+{
+    opcode = (memory[pc & 0x0FFFu] << 8u) | memory[(pc + 1u) & 0x0FFFu];
+    CHIP8_PROFILE_INSTRUCTION(profile, pc, opcode);
+    pc += 2;
+
+    unsigned int x = (opcode >> 8u) & 0xFu;
+    unsigned int y = (opcode >> 4u) & 0xFu;
+    unsigned int n = opcode & 0xFu;
+    uint8_t kk = opcode & 0xFFu;
+    uint16_t nnn = opcode & 0x0FFFu;
+
+    uint8_t& vx = registers[x];
+    uint8_t& vy = registers[y];
+    uint8_t& vf = registers[0xF];
+
+    switch (opcode >> 12u)
+    {
+        case 0x0:
+            // Only the low byte is decoded
+            if (Quirks::extendedDisplay && (kk & 0xF0u) == 0xC0u)
+            {
+                Scroll(*this, 0, n);
+                MarkRowsDirty(0, VideoHeight() - 1);
+            }
+            else if (Quirks::bitPlanes && (kk & 0xF0u) == 0xD0u)
+            {
+                Scroll(*this, 0, -static_cast<int>(n));
+                MarkRowsDirty(0, VideoHeight() - 1);
+            }
+            else if (Quirks::extendedDisplay && kk >= 0xFBu)
+            {
+                switch (kk)
+                {
+                    case 0xFB: Scroll(*this, 4, 0); break;
+                    case 0xFC: Scroll(*this, -4, 0); break;
+                    case 0xFD: pc -= 2; return;
+                    case 0xFE: SetMode(*this, false); break;
+                    case 0xFF: SetMode(*this, true); break;
+                }
+                MarkRowsDirty(0, VideoHeight() - 1);
+            }
+            else if (n == 0x0)
+            {
+                ClearSelected(*this);
+                MarkRowsDirty(0, VideoHeight() - 1);
+            }
+            else if (n == 0xE)
+            {
+                --sp;
+                pc = stack[sp & 0xFu];
+            }
+            break;
+
+        case 0x1:
+            pc = nnn;
+            break;
+
+        case 0x2:
+            stack[sp & 0xFu] = pc;
+            ++sp;
+            pc = nnn;
+            break;
+
+        case 0x3:
+            if (vx == kk)
+                pc += 2;
+            break;
+
+        case 0x4:
+            if (vx != kk)
+                pc += 2;
+            break;
+
+        case 0x5:
+            if (vx == vy)
+                pc += 2;
+            break;
+
+        case 0x6:
+            vx = kk;
+            break;
+
+        case 0x7:
+            vx += kk;
+            break;
+
+        case 0x8:
+            // The flag is written after Vx like in the OP_8xy* handlers, so it wins when x is F
+            switch (n)
+            {
+                case 0x0: vx = vy; break;
+                case 0x1: vx |= vy; if (Quirks::logicResetsVf) vf = 0; break;
+                case 0x2: vx &= vy; if (Quirks::logicResetsVf) vf = 0; break;
+                case 0x3: vx ^= vy; if (Quirks::logicResetsVf) vf = 0; break;
+                case 0x4:
+                {
+                    unsigned int sum = vx + vy;
+                    vx = static_cast<uint8_t>(sum);
+                    vf = sum > 0xFFu;
+                    break;
+                }
+                case 0x5:
+                {
+                    uint8_t notBorrow = vx > vy;
+                    vx -= vy;
+                    vf = notBorrow;
+                    break;
+                }
+                case 0x6:
+                {
+                    uint8_t source = Quirks::shiftUsesVy ? vy : vx;
+                    vx = source >> 1u;
+                    vf = source & 1u;
+                    break;
+                }
+                case 0x7:
+                {
+                    uint8_t notBorrow = vy > vx;
+                    vx = vy - vx;
+                    vf = notBorrow;
+                    break;
+                }
+                case 0xE:
+                {
+                    uint8_t source = Quirks::shiftUsesVy ? vy : vx;
+                    vx = source << 1u;
+                    vf = source >> 7u;
+                    break;
+                }
+            }
+            break;
+
+        case 0x9:
+            if (vx != vy)
+                pc += 2;
+            break;
+
+        case 0xA:
+            index = nnn;
+            break;
+
+        case 0xB:
+            pc = (Quirks::jumpUsesVx ? vx : registers[0]) + nnn;
+            break;
+
+        case 0xC:
+            vx = kk & randByte(randGen);
+            break;
+
+        case 0xD:
+            Draw(*this, x, y, n, Quirks::extendedDisplay, Quirks::clipSprites);
+            MarkRowsDirty(0, VideoHeight() - 1);
+            break;
+
+        case 0xE:
+            if (n == 0xE && KeyDown(vx))
+                pc += 2;
+            else if (n == 0x1 && !KeyDown(vx))
+                pc += 2;
+            break;
+
+        case 0xF:
+            switch (kk)
+            {
+                case 0x01:
+                    if (Quirks::bitPlanes)
+                        planes = x & ((1u << VIDEO_PLANES) - 1);
+                    break;
+
+                case 0x02:
+                    if (Quirks::bitPlanes)
+                    {
+                        for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; ++i)
+                            audioPattern[i] = memory[(index + i) & 0x0FFFu];
+                    }
+                    break;
+
+                case 0x07: vx = delayTimer; break;
+
+                case 0x0A:
+                {
+                    unsigned int key = 0;
+                    while (key < 16 && !KeyDown(key))
+                        ++key;
+
+                    if (key < 16)
+                        vx = key;
+                    else
+                        pc -= 2;
+                    break;
+                }
+
+                case 0x15: delayTimer = vx; break;
+                case 0x18: soundTimer = vx; break;
+                case 0x1E: index += vx; break;
+                case 0x29: index = FONTSET_START_ADDRESS + 5 * vx; break;
+
+                case 0x30:
+                    if (Quirks::extendedDisplay)
+                        index = BIG_FONTSET_START_ADDRESS + 10 * (vx & 0xFu);
+                    break;
+
+                case 0x3A:
+                    if (Quirks::bitPlanes)
+                        pitch = vx;
+                    break;
+
+                case 0x33:
+                    memory[(index + 2u) & 0x0FFFu] = vx % 10;
+                    memory[(index + 1u) & 0x0FFFu] = vx / 10 % 10;
+                    memory[index & 0x0FFFu] = vx / 100;
+                    MemoryWritten(index, 3);
+                    break;
+
+                case 0x55:
+                case 0x65:
+                    for (unsigned int i = 0; i <= x; ++i)
+                    {
+                        if (kk == 0x55)
+                            memory[(index + i) & 0x0FFFu] = registers[i];
+                        else
+                            registers[i] = memory[(index + i) & 0x0FFFu];
+                    }
+
+                    if (kk == 0x55)
+                        MemoryWritten(index, x + 1);
+
+                    if (Quirks::index == IndexQuirk::AddX)
+                        index += x;
+                    else if (Quirks::index == IndexQuirk::AddXPlus1)
+                        index += x + 1;
+                    break;
+            }
+            break;
+    }
+}
+
+template void Chip8::SwitchCycle<DefaultQuirks>();
+template void Chip8::SwitchCycle<CosmacVipQuirks>();
+template void Chip8::SwitchCycle<Chip48Quirks>();
+template void Chip8::SwitchCycle<SuperChipQuirks>();
+template void Chip8::SwitchCycle<XoChipQuirks>();
@@ -1,59 +1,1209 @@
+#include "Analyzer.hpp"
+#include "Audio.hpp"
 #include "Chip8.hpp"
+#include "Differential.hpp"
+#include "Disassembler.hpp"
+#include "FrameBuffer.hpp"
+#include "Golden.hpp"
+#include "Headless.hpp"
+#include "Lockstep.hpp"
+#include "Movie.hpp"
+#include "Profile.hpp"
+#ifndef CHIP8_NO_SDL
 #include "Platform.hpp"
+#endif
+#include "Rewind.hpp"
+#include "RomStore.hpp"
+#include "Runner.hpp"
+#include "Scheduler.hpp"
+#include "Snapshot.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main(int argc, char** argv)
+// Average undo storage reserved per frame of rewind history
+const unsigned int REWIND_BYTES_PER_FRAME = 256;
+
+// Command line settings
+struct Options
 {
-    // Check for correct command to run the executable with sufficient arguments
-    if (argc != 4)
+    bool headless = false;
+    bool batch = false;
+    bool lockstep = false;      // Batch mode runs the instances of a ROM as one LockstepBatch
+    char const* loadState = nullptr; // Headless: snapshot file to start from
+    char const* saveState = nullptr; // Headless: snapshot file written at the end
+    char const* record = nullptr;    // Windowed: movie file written on exit
+    char const* keymap = nullptr;    // Windowed: keymap file replacing the default key bindings
+    char const* audio = nullptr;     // Audio backend: sdl, null, none or a .wav file (nullptr = sdl in the window, none otherwise)
+    unsigned int audioBuffer = DEFAULT_AUDIO_BUFFER; // Samples per audio device buffer
+    char const* replay = nullptr;    // Movie file to replay headless
+    char const* goldenWrite = nullptr; // Golden file written from reference runs
+    char const* goldenCheck = nullptr; // Golden file to check the runs against
+    unsigned int checkpointFrames = 60; // Golden: frames between checkpoints
+    bool goldenFullState = false;       // Golden: checkpoints hash the whole machine
+    bool compare = false;               // Run --engine against compareEngine instruction by instruction
+    Engine compareEngine = Engine::Switch;
+    char const* analyze = nullptr;      // File the static analysis of a ROM is written to
+    bool staticAnalysis = true;         // Let the engines trust the static analysis of the program
+    bool skipIdle = true;               // Skip the passes of busy-wait loops
+    unsigned int rewindSeconds = 0;  // Windowed: length of the rewind history (0 = no rewind)
+    char const* profileJson = nullptr;   // Profile written as JSON on exit
+    char const* profileFolded = nullptr; // Profile written as folded stacks on exit
+    unsigned int threads = 0;   // 0 = one worker per hardware thread
+    unsigned int instances = 1; // Machines per ROM in batch mode, each with its own seed
+    unsigned int cyclesPerFrame = 0; // 0 = derive from <Delay> (or use the default when headless)
+    Engine engine = Engine::Interpreter;
+    QuirkProfile quirks = QuirkProfile::Default;
+    std::vector<char const*> positional;
+};
+
+static void PrintUsage(char const* program)
+{
+    std::cerr << "Usage: " << program << " [options] <Scale> <Delay> <ROM>\n"
+              << "       " << program << " --headless [options] <Cycles> <ROM>\n"
+              << "       " << program << " --batch [options] <Cycles> <ROM, directory or archive>...\n"
+              << "       " << program << " --replay <Movie> [--engine <name>] <ROM>\n"
+              << "       " << program << " --compare <Engine> [options] <Cycles> <ROM>\n"
+              << "       " << program << " --analyze <File.json|File.dot> [options] <ROM>\n"
+              << "       " << program << " --golden-write <File> [options] <Cycles> <ROM, directory or archive>...\n"
+              << "       " << program << " --golden-check <File> [options] [<ROM, directory or archive>...]\n"
+              << "Options:\n"
+              << "  --ipf <N>        Instructions executed per 60 Hz frame (overrides <Delay>)\n"
+              << "  --engine <name>  Execution engine: interpreter (default), block or switch\n"
+              << "  --quirks <name>  Instruction quirks: default, vip, chip48, schip or xochip\n"
+              << "  --threads <N>    Batch worker threads (default: all hardware threads)\n"
+              << "  --instances <N>  Batch machines per ROM, seeded 0 to N-1 (default: 1)\n"
+              << "  --lockstep       Batch: run the instances of a ROM in lockstep (no halt detection)\n"
+              << "  --checkpoint <N> Golden: frames between checkpoints (default: 60)\n"
+              << "  --golden-state <video|full>  Golden: hash the video (default) or the whole machine\n"
+              << "  --load-state <F> Headless, compare, analyze: restore a snapshot file after loading the ROM\n"
+              << "  --save-state <F> Headless: write a snapshot file of the final state\n"
+              << "  --rewind <S>     Keep S seconds of history, hold Backspace to rewind\n"
+              << "  --record <F>     Record the seed and keypad into a movie file for --replay\n"
+              << "  --audio <sdl|null|none|F.wav>  Play the sound (window only), render and discard it, mute it\n"
+              << "                   or write it to a WAV file (default: sdl in the window, none otherwise)\n"
+              << "  --audio-buffer <N>  Samples per audio device buffer, lower means less latency (default: 512)\n"
+              << "  --keymap <F>     Read the key bindings from a keymap file (lines of \"<hex key> <SDL key name>\")\n"
+              << "  --no-analysis    Keep checking every store for self-modifying code\n"
+              << "  --no-idle-skip   Execute busy-wait loops instead of skipping to the next frame\n"
+              << "  --profile <F>    Write opcode/PC/frame counters as JSON on exit (profiler builds)\n"
+              << "  --profile-folded <F>  Write the counters as folded stacks for flame graphs\n";
+}
+
+static bool IsWavFile(char const* filename)
+{
+    size_t length = std::strlen(filename);
+    return length > 4 && std::strcmp(filename + length - 4, ".wav") == 0;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
-        std::exit(EXIT_FAILURE);
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (std::strcmp(argv[i], "--batch") == 0)
+        {
+            options.batch = true;
+        }
+        else if (std::strcmp(argv[i], "--lockstep") == 0)
+        {
+            options.lockstep = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            int threads = std::stoi(argv[++i]);
+            if (threads <= 0)
+                return false;
+            options.threads = threads;
+        }
+        else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+        {
+            int instances = std::stoi(argv[++i]);
+            if (instances <= 0)
+                return false;
+            options.instances = instances;
+        }
+        else if (std::strcmp(argv[i], "--load-state") == 0 && i + 1 < argc)
+        {
+            options.loadState = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--save-state") == 0 && i + 1 < argc)
+        {
+            options.saveState = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            options.record = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--keymap") == 0 && i + 1 < argc)
+        {
+            options.keymap = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--audio") == 0 && i + 1 < argc)
+        {
+            options.audio = argv[++i];
+            if (std::strcmp(options.audio, "sdl") != 0 && std::strcmp(options.audio, "null") != 0 &&
+                std::strcmp(options.audio, "none") != 0 && !IsWavFile(options.audio))
+                return false;
+        }
+        else if (std::strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc)
+        {
+            int samples = std::stoi(argv[++i]);
+            if (samples <= 0 || samples > 32768)
+                return false;
+            options.audioBuffer = samples;
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            options.replay = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--golden-write") == 0 && i + 1 < argc)
+        {
+            options.goldenWrite = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--golden-check") == 0 && i + 1 < argc)
+        {
+            options.goldenCheck = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            int frames = std::stoi(argv[++i]);
+            if (frames <= 0)
+                return false;
+            options.checkpointFrames = frames;
+        }
+        else if (std::strcmp(argv[i], "--golden-state") == 0 && i + 1 < argc)
+        {
+            char const* name = argv[++i];
+            if (std::strcmp(name, "full") == 0)
+                options.goldenFullState = true;
+            else if (std::strcmp(name, "video") != 0)
+                return false;
+        }
+        else if (std::strcmp(argv[i], "--rewind") == 0 && i + 1 < argc)
+        {
+            int seconds = std::stoi(argv[++i]);
+            if (seconds <= 0)
+                return false;
+            options.rewindSeconds = seconds;
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            options.profileJson = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile-folded") == 0 && i + 1 < argc)
+        {
+            options.profileFolded = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+        {
+            int cycles = std::stoi(argv[++i]);
+            if (cycles <= 0)
+                return false;
+            options.cyclesPerFrame = cycles;
+        }
+        else if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            if (!ParseEngine(argv[++i], options.engine))
+                return false;
+        }
+        else if (std::strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+        {
+            if (!ParseEngine(argv[++i], options.compareEngine))
+                return false;
+            options.compare = true;
+        }
+        else if (std::strcmp(argv[i], "--analyze") == 0 && i + 1 < argc)
+        {
+            options.analyze = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-analysis") == 0)
+        {
+            options.staticAnalysis = false;
+        }
+        else if (std::strcmp(argv[i], "--no-idle-skip") == 0)
+        {
+            options.skipIdle = false;
+        }
+        else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            if (!ParseQuirkProfile(argv[++i], options.quirks))
+                return false;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            options.positional.push_back(argv[i]);
+        }
+    }
+
+    // At most one of the headless modes
+    if (options.headless + options.batch + options.compare + (options.replay != nullptr) +
+        (options.goldenWrite != nullptr) + (options.goldenCheck != nullptr) + (options.analyze != nullptr) > 1)
+        return false;
+
+    // Audio is played in the window and rendered in headless and replay runs
+    if (options.audio && (options.batch || options.compare || options.goldenWrite || options.goldenCheck || options.analyze))
+        return false;
+
+    if (options.audio && std::strcmp(options.audio, "sdl") == 0 && (options.headless || options.replay))
+        return false;
+
+    if (options.goldenCheck)
+        return true;
+
+    if (options.batch || options.goldenWrite)
+        return options.positional.size() >= 2u;
+
+    if (options.replay || options.analyze)
+        return options.positional.size() == 1u;
+
+    if (options.compare)
+        return options.positional.size() == 2u;
+
+    // A rewound session cannot be replayed
+    if (options.record && (options.headless || options.rewindSeconds))
+        return false;
+
+    if (options.keymap && options.headless)
+        return false;
+
+    return options.positional.size() == (options.headless ? 2u : 3u);
+}
+
+#ifdef CHIP8_PROFILE
+// Attaches a profile to chip8 when one was requested on the command line
+static std::unique_ptr<Profile> StartProfile(Options const& options, Chip8& chip8)
+{
+    std::unique_ptr<Profile> profile;
+
+    if (options.profileJson || options.profileFolded)
+    {
+        profile.reset(new Profile);
+        chip8.profile = profile.get();
+    }
+
+    return profile;
+}
+
+// Writes the profile files requested on the command line
+static void WriteProfile(Options const& options, Profile const* profile)
+{
+    if (!profile)
+        return;
+
+    if (options.profileJson && !profile->WriteJson(options.profileJson))
+        std::cerr << "Could not write profile: " << options.profileJson << '\n';
+
+    if (options.profileFolded && !profile->WriteFolded(options.profileFolded))
+        std::cerr << "Could not write profile: " << options.profileFolded << '\n';
+}
+#endif
+
+// Renders the sound of chip8 into the backend chosen with --audio (ring: the window's audio
+// device for sdl). Leaves audio empty for none, or when there is no audio device. Returns false
+// when the WAV file cannot be created.
+static bool StartAudio(char const* backend, Chip8& chip8, std::unique_ptr<AudioStream>& audio, SampleRing* ring = nullptr)
+{
+    std::unique_ptr<AudioSink> sink;
+
+    if (std::strcmp(backend, "none") == 0)
+        return true;
+    else if (std::strcmp(backend, "null") == 0)
+        sink.reset(new NullAudioSink);
+    else if (std::strcmp(backend, "sdl") == 0 && ring)
+        sink.reset(new RingAudioSink(*ring));
+    else if (std::strcmp(backend, "sdl") == 0)
+    {
+        std::cerr << "No audio device, running without sound\n";
+        return true;
+    }
+    else
+    {
+        WavAudioSink* wav = new WavAudioSink(backend, DEFAULT_SAMPLE_RATE);
+        sink.reset(wav);
+        if (!wav->IsOpen())
+        {
+            std::cerr << "Could not write audio: " << backend << '\n';
+            return false;
+        }
+    }
+
+    audio.reset(new AudioStream(std::move(sink), DEFAULT_SAMPLE_RATE));
+    chip8.audio = audio.get();
+    return true;
+}
+
+// Completes the WAV file of a --audio run and prints what was rendered. Returns false when the
+// WAV file could not be written.
+static bool FinishAudio(char const* backend, AudioStream* audio, bool report)
+{
+    if (!audio)
+        return true;
+
+    if (report)
+    {
+        std::cout << "Audio: " << audio->Samples() << " samples, " << audio->AudibleSamples() << " audible, hash "
+                  << std::hex << audio->Hash() << std::dec << '\n';
+    }
+
+    if (IsWavFile(backend) && !static_cast<WavAudioSink&>(audio->Sink()).Close())
+    {
+        std::cerr << "Could not write audio: " << backend << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+// Runs a ROM without any window for a fixed number of cycles and dumps the final state
+static int RunHeadlessMode(Options const& options)
+{
+    uint64_t maxCycles = std::stoull(options.positional[0]);
+    char const* romFilename = options.positional[1];
+    unsigned int cyclesPerFrame = options.cyclesPerFrame ? options.cyclesPerFrame : DEFAULT_CYCLES_PER_FRAME;
+
+    // Instantiate Chip-8 Emulation Engine
+    Chip8 chip8(options.quirks);
+
+    // Load the ROM
+    if (!chip8.LoadROM(romFilename))
+    {
+        std::cerr << "Could not open ROM: " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Snapshot buffer, reused for loading and saving
+    static uint8_t snapshot[SNAPSHOT_SIZE];
+
+    // Continue from a saved state
+    if (options.loadState)
+    {
+        if (!ReadSnapshotFile(options.loadState, snapshot, sizeof(snapshot)) ||
+            !RestoreSnapshot(chip8, snapshot, sizeof(snapshot)))
+        {
+            std::cerr << "Could not load snapshot: " << options.loadState << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.staticAnalysis)
+        UseStaticAnalysis(chip8);
+
+    std::unique_ptr<AudioStream> audio;
+    if (options.audio && !StartAudio(options.audio, chip8, audio))
+        return EXIT_FAILURE;
+
+#ifdef CHIP8_PROFILE
+    std::unique_ptr<Profile> profile = StartProfile(options, chip8);
+#endif
+
+    HeadlessResult result = RunHeadless(chip8, maxCycles, cyclesPerFrame, options.engine, options.skipIdle);
+
+#ifdef CHIP8_PROFILE
+    WriteProfile(options, profile.get());
+#endif
+
+    // Keep the final state for a later run
+    if (options.saveState)
+    {
+        SaveSnapshot(chip8, snapshot, sizeof(snapshot));
+        if (!WriteSnapshotFile(options.saveState, snapshot, sizeof(snapshot)))
+        {
+            std::cerr << "Could not write snapshot: " << options.saveState << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Throughput in millions of instructions per second
+    double mips = result.seconds > 0.0 ? result.cycles / result.seconds / 1e6 : 0.0;
+
+    std::cout << "Cycles: " << result.cycles << '\n'
+              << "Idle: " << result.idleCycles << '\n'
+              << "Halt: " << HaltReasonName(result.reason) << '\n'
+              << "Time: " << result.seconds << " s\n"
+              << "MIPS: " << mips << '\n';
+
+    if (!FinishAudio(options.audio, audio.get(), true))
+        return EXIT_FAILURE;
+
+    DumpState(chip8, std::cout);
+
+    return EXIT_SUCCESS;
+}
+
+// Replays a recorded movie at full speed and checks that it ends on the recorded screen
+static int RunReplayMode(Options const& options)
+{
+    char const* romFilename = options.positional[0];
+
+    Movie movie;
+    if (!ReadMovieFile(options.replay, movie))
+    {
+        std::cerr << "Could not read movie: " << options.replay << '\n';
+        return EXIT_FAILURE;
+    }
+
+    RomStore store;
+    RomImage const* rom = store.AddFile(romFilename);
+    if (!rom)
+    {
+        std::cerr << "Could not open ROM: " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (rom->hash != movie.romHash)
+    {
+        std::cerr << "The movie was not recorded with " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // The movie's quirks and speed, so the replay executes exactly what was recorded
+    Chip8 chip8(movie.quirks);
+    chip8.LoadROM(rom->data, rom->size);
+
+    if (options.staticAnalysis)
+        UseStaticAnalysis(chip8);
+
+    std::unique_ptr<AudioStream> audio;
+    if (options.audio && !StartAudio(options.audio, chip8, audio))
+        return EXIT_FAILURE;
+
+#ifdef CHIP8_PROFILE
+    std::unique_ptr<Profile> profile = StartProfile(options, chip8);
+#endif
+
+    HeadlessResult result = ReplayMovie(chip8, movie, options.engine, options.skipIdle);
+
+#ifdef CHIP8_PROFILE
+    WriteProfile(options, profile.get());
+#endif
+
+    uint64_t videoHash = HashVideo(chip8);
+    double mips = result.seconds > 0.0 ? result.cycles / result.seconds / 1e6 : 0.0;
+
+    std::cout << "Cycles: " << result.cycles << '\n'
+              << "Events: " << movie.events.size() << '\n'
+              << "Idle: " << result.idleCycles << '\n'
+              << "Time: " << result.seconds << " s\n"
+              << "MIPS: " << mips << '\n'
+              << "Video: " << std::hex << videoHash << " (recorded " << movie.videoHash << ")" << std::dec << '\n';
+
+    if (!FinishAudio(options.audio, audio.get(), true))
+        return EXIT_FAILURE;
+
+    if (videoHash != movie.videoHash)
+    {
+        std::cout << "Replay: mismatch\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Replay: ok\n";
+    return EXIT_SUCCESS;
+}
+
+// Writes the static analysis of a ROM (JSON, or DOT for a .dot file) and prints a summary
+static int RunAnalyzeMode(Options const& options)
+{
+    char const* romFilename = options.positional[0];
+
+    RomStore store;
+    RomImage const* rom = store.AddFile(romFilename);
+    Chip8 chip8(options.quirks);
+    if (!rom || !chip8.LoadROM(rom->data, rom->size))
+    {
+        std::cerr << "Could not open ROM: " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Analyze a saved state instead of the program start
+    if (options.loadState)
+    {
+        static uint8_t snapshot[SNAPSHOT_SIZE];
+        if (!ReadSnapshotFile(options.loadState, snapshot, sizeof(snapshot)) ||
+            !RestoreSnapshot(chip8, snapshot, sizeof(snapshot)))
+        {
+            std::cerr << "Could not load snapshot: " << options.loadState << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    RomAnalysis analysis = AnalyzeProgram(chip8, rom->size);
+
+    std::ofstream file(options.analyze);
+    size_t length = std::strlen(options.analyze);
+    if (length >= 4 && std::strcmp(options.analyze + length - 4, ".dot") == 0)
+        WriteAnalysisDot(analysis, file);
+    else
+        WriteAnalysisJson(analysis, file);
+
+    if (!file)
+    {
+        std::cerr << "Could not write analysis: " << options.analyze << '\n';
+        return EXIT_FAILURE;
+    }
+
+    unsigned int codeBytes = 0;
+    unsigned int dataBytes = 0;
+    for (MemoryRegion const& region : analysis.regions)
+        (region.code ? codeBytes : dataBytes) += region.end - region.first;
+
+    unsigned int codeStores = 0;
+    for (MemoryStore const& store : analysis.stores)
+        codeStores += store.writesCode;
+
+    std::cout << "Instructions: " << analysis.instructions.size() << '\n'
+              << "Code: " << codeBytes << " bytes\n"
+              << "Data: " << dataBytes << " bytes\n"
+              << "Indirect jumps: " << analysis.indirectJumps.size() << '\n'
+              << "Stores: " << analysis.stores.size() << " (" << codeStores << " may write code)\n"
+              << "Static code: " << (analysis.StaticCode() ? "yes" : "no") << '\n';
+
+    return EXIT_SUCCESS;
+}
+
+// Runs --engine and the --compare engine side by side from the same state and stops at the
+// first instruction (or block) after which their states differ
+static int RunCompareMode(Options const& options)
+{
+    uint64_t maxCycles = std::stoull(options.positional[0]);
+    char const* romFilename = options.positional[1];
+    unsigned int cyclesPerFrame = options.cyclesPerFrame ? options.cyclesPerFrame : DEFAULT_CYCLES_PER_FRAME;
+
+    // Machines are too big for comfortable stack use
+    std::unique_ptr<Chip8> a(new Chip8(options.quirks));
+    std::unique_ptr<Chip8> b(new Chip8(options.quirks));
+
+    if (!a->LoadROM(romFilename) || !b->LoadROM(romFilename))
+    {
+        std::cerr << "Could not open ROM: " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    a->randGen.seed(0);
+    b->randGen.seed(0);
+
+    if (options.loadState)
+    {
+        static uint8_t snapshot[SNAPSHOT_SIZE];
+        if (!ReadSnapshotFile(options.loadState, snapshot, sizeof(snapshot)) ||
+            !RestoreSnapshot(*a, snapshot, sizeof(snapshot)) || !RestoreSnapshot(*b, snapshot, sizeof(snapshot)))
+        {
+            std::cerr << "Could not load snapshot: " << options.loadState << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Only the --engine machine trusts the analysis, so a wrong one shows up as a divergence
+    if (options.staticAnalysis)
+        UseStaticAnalysis(*a);
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    Divergence divergence = CompareEngines(*a, options.engine, *b, options.compareEngine, 0, maxCycles, cyclesPerFrame);
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Engines: " << EngineName(options.engine) << " vs " << EngineName(options.compareEngine) << '\n'
+              << "Time: " << std::chrono::duration<double>(endTime - startTime).count() << " s\n";
+
+    if (!divergence.found)
+    {
+        std::cout << "Cycles: " << maxCycles << '\n'
+                  << "Result: match\n";
+        return EXIT_SUCCESS;
+    }
+
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << "Cycles: " << divergence.cycle << '\n'
+              << "Result: diverged after " << divergence.instructions << " more instruction(s) from\n"
+              << "  " << std::hex << std::uppercase << divergence.pc << ": " << divergence.opcode
+              << "  " << Disassemble(divergence.opcode, options.quirks) << '\n';
+    std::cout.flags(flags);
+
+    std::cout << "Differences (" << EngineName(options.engine) << " vs " << EngineName(options.compareEngine) << "):\n";
+    DescribeDifferences(*a, *b, std::cout);
+
+    return EXIT_FAILURE;
+}
+
+// Maps the ROM arguments of a batch (the positional arguments from first on) into store,
+// directories and ROM archives expand to the ROMs inside them. Files that cannot be mapped
+// are kept in the list (and reported as failed machines).
+static std::vector<std::string> CollectRoms(Options const& options, RomStore& store, size_t first = 1)
+{
+    std::vector<std::string> names;
+
+    for (size_t arg = first; arg < options.positional.size(); ++arg)
+    {
+        std::string path = options.positional[arg];
+
+        if (!store.AddDirectory(path, names) && !store.AddArchive(path, names))
+        {
+            store.AddFile(path);
+            names.push_back(path);
+        }
+    }
+
+    return names;
+}
+
+// Runs the --instances machines of every ROM together in a structure-of-arrays batch
+static int RunLockstepMode(Options const& options)
+{
+    uint64_t maxCycles = std::stoull(options.positional[0]);
+    unsigned int cyclesPerFrame = options.cyclesPerFrame ? options.cyclesPerFrame : DEFAULT_CYCLES_PER_FRAME;
+
+    bool failed = false;
+    uint64_t totalCycles = 0;
+    double totalSeconds = 0.0;
+
+    RomStore store;
+    for (std::string const& name : CollectRoms(options, store))
+    {
+        char const* romFilename = name.c_str();
+        RomImage const* rom = store.Find(name);
+
+        LockstepBatch batch(options.instances);
+        if (!rom || !batch.LoadROM(rom->data, rom->size))
+        {
+            std::cout << romFilename << " error=could-not-open\n";
+            failed = true;
+            continue;
+        }
+
+        // Lockstep batches mirror the default instruction behaviour only
+        if (rom->hasQuirks && rom->quirks != QuirkProfile::Default)
+        {
+            std::cout << romFilename << " error=unsupported-quirks\n";
+            failed = true;
+            continue;
+        }
+
+        for (unsigned int lane = 0; lane < batch.Lanes(); ++lane)
+            batch.Seed(lane, lane);
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        batch.Run(maxCycles, rom->cyclesPerFrame ? rom->cyclesPerFrame : cyclesPerFrame);
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        totalCycles += maxCycles * batch.Lanes();
+        totalSeconds += std::chrono::duration<double>(endTime - startTime).count();
+
+        // One line per machine, in the same format as the threaded batch
+        Chip8 chip8;
+        for (unsigned int lane = 0; lane < batch.Lanes(); ++lane)
+        {
+            batch.CopyTo(lane, chip8);
+            std::cout << romFilename << " seed=" << lane
+                      << " cycles=" << maxCycles
+                      << " halt=" << HaltReasonName(HaltReason::CycleLimit)
+                      << " video=" << std::hex << HashVideo(chip8) << std::dec << '\n';
+        }
+
+        std::cout << romFilename << " converged=" << batch.convergedSteps
+                  << " diverged=" << batch.divergedSteps << '\n';
+    }
+
+    double mips = totalSeconds > 0.0 ? totalCycles / totalSeconds / 1e6 : 0.0;
+    std::cout << "Cycles: " << totalCycles << '\n'
+              << "Time: " << totalSeconds << " s\n"
+              << "MIPS: " << mips << '\n';
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Runs every ROM (times --instances) on its own headless machine across all cores
+static int RunBatchMode(Options const& options)
+{
+    uint64_t maxCycles = std::stoull(options.positional[0]);
+
+    // Every ROM is mapped once and shared by all of its machines
+    RomStore store;
+
+    std::vector<RunnerJob> jobs;
+    for (std::string const& name : CollectRoms(options, store))
+    {
+        for (unsigned int seed = 0; seed < options.instances; ++seed)
+        {
+            RunnerJob job;
+            job.romFilename = name;
+            job.seed = seed;
+            job.maxCycles = maxCycles;
+            jobs.push_back(job);
+        }
+    }
+
+    RunnerOptions runnerOptions;
+    runnerOptions.threads = options.threads;
+    runnerOptions.engine = options.engine;
+    runnerOptions.quirks = options.quirks;
+    runnerOptions.staticAnalysis = options.staticAnalysis;
+    runnerOptions.skipIdle = options.skipIdle;
+    if (options.cyclesPerFrame)
+        runnerOptions.cyclesPerFrame = options.cyclesPerFrame;
+
+    std::vector<RunnerResult> results;
+    RunnerStats stats = RunBatch(jobs, runnerOptions, results, &store);
+
+    // One line per machine
+    bool failed = false;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        RunnerResult const& result = results[i];
+        std::cout << jobs[i].romFilename << " seed=" << jobs[i].seed;
+
+        if (!result.loaded)
+        {
+            std::cout << " error=could-not-open\n";
+            failed = true;
+            continue;
+        }
+
+        double mips = result.run.seconds > 0.0 ? result.run.cycles / result.run.seconds / 1e6 : 0.0;
+        std::cout << " cycles=" << result.run.cycles
+                  << " idle=" << result.run.idleCycles
+                  << " halt=" << HaltReasonName(result.run.reason)
+                  << " video=" << std::hex << result.videoHash << std::dec
+                  << " worker=" << result.worker
+                  << " mips=" << mips << '\n';
+    }
+
+    // Aggregate throughput of the whole farm
+    double mips = stats.seconds > 0.0 ? stats.totalCycles / stats.seconds / 1e6 : 0.0;
+    std::cout << "Machines: " << jobs.size() << '\n'
+              << "Threads: " << stats.threads << '\n'
+              << "Steals: " << stats.steals << '\n'
+              << "Cycles: " << stats.totalCycles << '\n'
+              << "Time: " << stats.seconds << " s\n"
+              << "MIPS: " << mips << '\n';
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Builds the batch jobs of a golden file: every ROM (times --instances) up to cycles
+static std::vector<RunnerJob> GoldenJobs(std::vector<std::string> const& names, unsigned int instances, uint64_t cycles)
+{
+    std::vector<RunnerJob> jobs;
+
+    for (std::string const& name : names)
+    {
+        for (unsigned int seed = 0; seed < instances; ++seed)
+        {
+            RunnerJob job;
+            job.romFilename = name;
+            job.seed = seed;
+            job.maxCycles = cycles;
+            jobs.push_back(job);
+        }
+    }
+
+    return jobs;
+}
+
+// Runs a batch with the reference interpreter and stores its checkpoint hashes
+static int RunGoldenWriteMode(Options const& options)
+{
+    GoldenSettings settings;
+    settings.cycles = std::stoull(options.positional[0]);
+    if (options.cyclesPerFrame)
+        settings.cyclesPerFrame = options.cyclesPerFrame;
+    settings.quirks = options.quirks;
+    settings.checkpointFrames = options.checkpointFrames;
+    settings.fullState = options.goldenFullState;
+
+    RomStore store;
+    std::vector<RunnerJob> jobs = GoldenJobs(CollectRoms(options, store), options.instances, settings.cycles);
+
+    RunnerOptions runnerOptions;
+    runnerOptions.threads = options.threads;
+    runnerOptions.cyclesPerFrame = settings.cyclesPerFrame;
+    runnerOptions.quirks = settings.quirks;
+    runnerOptions.checkpointFrames = settings.checkpointFrames;
+    runnerOptions.checkpointState = settings.fullState;
+
+    std::vector<RunnerResult> results;
+    RunnerStats stats = RunBatch(jobs, runnerOptions, results, &store);
+
+    bool failed = false;
+    std::vector<GoldenRecord> records;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!results[i].loaded)
+        {
+            std::cout << jobs[i].romFilename << " seed=" << jobs[i].seed << " error=could-not-open\n";
+            failed = true;
+            continue;
+        }
+
+        GoldenRecord record;
+        record.romName = jobs[i].romFilename;
+        record.seed = jobs[i].seed;
+        record.cycles = results[i].run.cycles;
+        record.halt = HaltReasonName(results[i].run.reason);
+        record.checkpoints = results[i].checkpoints;
+        records.push_back(record);
+    }
+
+    if (!WriteGoldenFile(options.goldenWrite, settings, records))
+    {
+        std::cerr << "Could not write golden file: " << options.goldenWrite << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Machines: " << records.size() << '\n'
+              << "Cycles: " << stats.totalCycles << '\n'
+              << "Time: " << stats.seconds << " s\n";
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Reruns the machines of a golden file with --engine and reports, for every machine that
+// does not reproduce its checkpoints, the first step at which it left the reference interpreter
+static int RunGoldenCheckMode(Options const& options)
+{
+    GoldenSettings settings;
+    std::vector<GoldenRecord> records;
+    if (!ReadGoldenFile(options.goldenCheck, settings, records))
+    {
+        std::cerr << "Could not read golden file: " << options.goldenCheck << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Archives (and directories) given on the command line provide the ROMs by name
+    RomStore store;
+    CollectRoms(options, store, 0);
+
+    std::vector<RunnerJob> jobs;
+    for (GoldenRecord const& record : records)
+    {
+        RunnerJob job;
+        job.romFilename = record.romName;
+        job.seed = record.seed;
+        job.maxCycles = settings.cycles;
+        jobs.push_back(job);
     }
 
-    int videoScale = std::stoi(argv[1]);
-    int cycleDelay = std::stoi(argv[2]);
-    char const* romFilename = argv[3];
+    RunnerOptions runnerOptions;
+    runnerOptions.threads = options.threads;
+    runnerOptions.engine = options.engine;
+    runnerOptions.staticAnalysis = options.staticAnalysis;
+    runnerOptions.skipIdle = options.skipIdle;
+    runnerOptions.cyclesPerFrame = settings.cyclesPerFrame;
+    runnerOptions.quirks = settings.quirks;
+    runnerOptions.checkpointFrames = settings.checkpointFrames;
+    runnerOptions.checkpointState = settings.fullState;
+
+    std::vector<RunnerResult> results;
+    RunnerStats stats = RunBatch(jobs, runnerOptions, results, &store);
+
+    unsigned int mismatches = 0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        GoldenRecord const& record = records[i];
+        RunnerResult const& result = results[i];
+        std::cout << record.romName << " seed=" << record.seed;
+
+        if (!result.loaded)
+        {
+            std::cout << " error=could-not-open\n";
+            ++mismatches;
+            continue;
+        }
+
+        // First checkpoint that differs (a run that ended early or late lacks or has extra ones)
+        size_t checkpoint = 0;
+        while (checkpoint < record.checkpoints.size() && checkpoint < result.checkpoints.size() &&
+               record.checkpoints[checkpoint] == result.checkpoints[checkpoint])
+            ++checkpoint;
+
+        if (checkpoint == record.checkpoints.size() && checkpoint == result.checkpoints.size() &&
+            record.cycles == result.run.cycles && record.halt == HaltReasonName(result.run.reason))
+        {
+            std::cout << " ok\n";
+            continue;
+        }
+
+        ++mismatches;
+
+        // Narrow the mismatch down to a single step between the last good checkpoint and this one
+        RomImage const* rom = store.Find(record.romName);
+        unsigned int cyclesPerFrame = rom->cyclesPerFrame ? rom->cyclesPerFrame : settings.cyclesPerFrame;
+        uint64_t interval = uint64_t(settings.checkpointFrames) * cyclesPerFrame;
+        uint64_t fromCycle = checkpoint * interval;
+        uint64_t toCycle = std::min(fromCycle + interval, settings.cycles);
+
+        std::cout << " mismatch checkpoint=" << checkpoint << " cycle=" << std::min(toCycle, record.cycles);
+
+        Divergence divergence = FindDivergence(*rom, record.seed, settings, options.engine, fromCycle, toCycle,
+                                               options.staticAnalysis);
+        if (!divergence.found)
+        {
+            // The engine agrees with today's reference interpreter, so the reference changed
+            std::cout << " diverged=reference\n";
+            continue;
+        }
+
+        std::ios::fmtflags flags = std::cout.flags();
+        std::cout << " diverged=" << divergence.cycle
+                  << " pc=" << std::hex << std::uppercase << divergence.pc
+                  << " opcode=" << divergence.opcode;
+        std::cout.flags(flags);
+        std::cout << " instructions=" << divergence.instructions
+                  << " asm=\"" << Disassemble(divergence.opcode, rom->hasQuirks ? rom->quirks : settings.quirks) << "\"\n";
+    }
+
+    std::cout << "Machines: " << jobs.size() << '\n'
+              << "Mismatches: " << mismatches << '\n'
+              << "Cycles: " << stats.totalCycles << '\n'
+              << "Time: " << stats.seconds << " s\n";
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#ifndef CHIP8_NO_SDL
+// Runs a ROM in an SDL window, paced in 60 Hz frames
+static int RunWindowedMode(Options const& options)
+{
+    int videoScale = std::stoi(options.positional[0]);
+    int cycleDelay = std::stoi(options.positional[1]);
+    char const* romFilename = options.positional[2];
 
     // Instantiate SDL2 based graphical platform
+    // (the texture fits the hi-res mode, lo-res screens use its top-left quarter)
     Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale,
-                      VIDEO_WIDTH, VIDEO_HEIGHT);
+                      HIRES_VIDEO_WIDTH, HIRES_VIDEO_HEIGHT);
+
+    if (options.keymap)
+    {
+        Keymap keymap;
+        if (!ReadKeymapFile(options.keymap, keymap))
+        {
+            std::cerr << "Could not read keymap: " << options.keymap << '\n';
+            return EXIT_FAILURE;
+        }
+        if (!platform.SetKeymap(keymap))
+            std::cerr << "Keymap " << options.keymap << " has unknown keys, they are ignored\n";
+    }
 
-    // Instantiate Chip-8 Emulation Engine 
-    Chip8 chip8;
+    // Instantiate Chip-8 Emulation Engine
+    Chip8 chip8(options.quirks);
 
     // Load the ROM
-    chip8.LoadROM(romFilename);
+    RomStore store;
+    RomImage const* rom = store.AddFile(romFilename);
+    if (!rom || !chip8.LoadROM(rom->data, rom->size))
+    {
+        std::cerr << "Could not open ROM: " << romFilename << '\n';
+        return EXIT_FAILURE;
+    }
 
-    // Specify the bytes occupied by a single row of display (size of one pixel multiplied by Width)
-    int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
+    if (options.staticAnalysis)
+        UseStaticAnalysis(chip8);
 
-    auto lastCycleTime = std::chrono::high_resolution_clock::now(); // Starting time
-    bool quit = false; // variable to check if the exit condition is true
+    // Sound: the audio device unless --audio chose another backend
+    char const* audioBackend = options.audio ? options.audio : "sdl";
+    SampleRing* audioRing = nullptr;
+    if (std::strcmp(audioBackend, "sdl") == 0)
+        audioRing = platform.OpenAudio(DEFAULT_SAMPLE_RATE, options.audioBuffer);
 
-    // Run the emulation cycles in loop until exit condition becomes true
-    while(!quit)
+    std::unique_ptr<AudioStream> audio;
+    if (!StartAudio(audioBackend, chip8, audio, audioRing))
+        return EXIT_FAILURE;
+
+    // CPU speed, timers and display refresh are paced per 60 Hz frame
+    FrameScheduler scheduler(options.cyclesPerFrame ? options.cyclesPerFrame : CyclesPerFrameFromDelay(cycleDelay),
+                             TIMER_FREQUENCY, options.engine, options.skipIdle);
+
+    // Optional movie: the (still clock based) seed is recorded along with every keypad change
+    std::unique_ptr<Movie> movie;
+    uint64_t cycles = 0; // Instructions executed so far
+    if (options.record)
     {
-        // Register key input
-        quit = platform.ProcessInput(chip8.keypad);
+        movie.reset(new Movie);
+        movie->quirks = options.quirks;
+        movie->romHash = rom->hash;
+        movie->seed = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count());
+        movie->cyclesPerFrame = scheduler.CyclesPerFrame();
+        chip8.randGen.seed(static_cast<RandomEngine::result_type>(movie->seed));
+    }
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
+    // Optional rewind history, one checkpoint per frame
+    std::unique_ptr<RewindBuffer> rewind;
+    if (options.rewindSeconds)
+    {
+        unsigned int frames = options.rewindSeconds * TIMER_FREQUENCY;
+        rewind.reset(new RewindBuffer(frames, frames * REWIND_BYTES_PER_FRAME));
+        rewind->Reset(chip8);
+    }
 
-        // Variable to store elapsed time between last cycle and this one
-        float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+#ifdef CHIP8_PROFILE
+    std::unique_ptr<Profile> profile = StartProfile(options, chip8);
+#endif
 
-        if (dt > cycleDelay)
+    // The emulation runs on its own thread at the scheduler's pace; this thread polls the input
+    // and presents the latest completed frame, so a slow present never holds the CPU back
+    std::atomic<bool> quit{};
+    FrameTripleBuffer frames;
+
+    std::thread emulation([&]()
+    {
+        while (!quit.load(std::memory_order_relaxed))
+        {
+            // Latch the keys collected since the last frame, the keypad stays the same during the frame
+            uint16_t keypad = platform.Keypad().Latch();
+            chip8.keypad = keypad;
+
+            if (movie)
+                movie->RecordKeypad(cycles, keypad);
+
+            if (rewind && platform.RewindHeld())
+            {
+                // Step back one frame, but keep the keys that are held right now
+                rewind->Rewind(chip8, rewind->Count() > 0 ? 1 : 0);
+                chip8.keypad = keypad;
+            }
+            else
+            {
+                // Execute the frame's instruction budget and tick the timers
+                scheduler.RunFrame(chip8);
+                cycles += scheduler.CyclesPerFrame();
+
+                if (rewind)
+                    rewind->Checkpoint(chip8);
+            }
+
+            // Publish a frame only when video changed
+            if (chip8.videoDirty)
+                frames.Publish(chip8);
+
+            // Sleep until the next frame
+            scheduler.WaitForNextFrame();
+        }
+    });
+
+    uint64_t shown = 0; // Sequence of the frame on screen
+    while (!quit.load(std::memory_order_relaxed))
+    {
         {
-            // Update the last cycle time to current time
-            lastCycleTime = currentTime;
+            CHIP8_PROFILE_SCOPE(chip8.profile, input);
+            if (platform.ProcessInput())
+                quit.store(true, std::memory_order_relaxed);
+        }
+
+        VideoFrame const* frame = frames.Latest();
+        if (!frame)
+        {
+            // Nothing new to show, keep polling the input
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Only the dirty rows changed since the frame on screen, unless frames were dropped
+        unsigned int firstRow = frame->dirtyRowFirst;
+        unsigned int rowCount = frame->dirtyRowLast - frame->dirtyRowFirst + 1;
+        if (frame->sequence != shown + 1)
+        {
+            firstRow = 0;
+            rowCount = frame->Height();
+        }
+        shown = frame->sequence;
+
+        CHIP8_PROFILE_SCOPE(chip8.profile, update);
+        platform.Update(frame->video, frame->twoPlanes ? &frame->video[VIDEO_PLANE_WORDS] : nullptr,
+                        frame->Width(), frame->Height(), firstRow, rowCount);
+    }
+
+    emulation.join();
+
+#ifdef CHIP8_PROFILE
+    WriteProfile(options, profile.get());
+#endif
 
-            // Execute the emulation cycle
-            chip8.Cycle();
+    if (!FinishAudio(audioBackend, audio.get(), false))
+        return EXIT_FAILURE;
 
-            // Update the display
-            platform.Update(chip8.video, videoPitch);
+    if (movie)
+    {
+        movie->cycles = cycles;
+        movie->videoHash = HashVideo(chip8);
+        if (!WriteMovieFile(options.record, *movie))
+        {
+            std::cerr << "Could not write movie: " << options.record << '\n';
+            return EXIT_FAILURE;
         }
     }
 
-    return 0;
-}
\ No newline at end of file
+    return EXIT_SUCCESS;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    // Check for correct command to run the executable with sufficient arguments
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+#ifndef CHIP8_PROFILE
+    if (options.profileJson || options.profileFolded)
+    {
+        std::cerr << "This build has no profiler (configure with -DCHIP8_PROFILER=ON)\n";
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // Headless mode: no SDL window, run the interpreter flat-out
+    if (options.headless)
+        return RunHeadlessMode(options);
+
+    // Replay mode: a recorded session, headless and flat-out
+    if (options.replay)
+        return RunReplayMode(options);
+
+    // Differential mode: two engines in lockstep
+    if (options.compare)
+        return RunCompareMode(options);
+
+    // Static analysis of a ROM
+    if (options.analyze)
+        return RunAnalyzeMode(options);
+
+    // Golden files: reference checkpoints of a batch, and checking an engine against them
+    if (options.goldenWrite)
+        return RunGoldenWriteMode(options);
+    if (options.goldenCheck)
+        return RunGoldenCheckMode(options);
+
+    // Lockstep batches mirror the default instruction behaviour only
+    if (options.lockstep && options.quirks != QuirkProfile::Default)
+    {
+        std::cerr << "--lockstep supports the default quirk profile only\n";
+        return EXIT_FAILURE;
+    }
+
+    // Batch mode: many headless machines on a thread pool
+    if (options.batch)
+        return options.lockstep ? RunLockstepMode(options) : RunBatchMode(options);
+
+#ifdef CHIP8_NO_SDL
+    std::cerr << "This build has no window support (built without SDL2), use --headless or --batch\n";
+    return EXIT_FAILURE;
+#else
+    return RunWindowedMode(options);
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cstdlib>
+#include <iostream>
+
+// Checks shared by the ctest programs: a failed check is reported on stderr and counted, and
+// main returns TestResult() so that any failure fails the test.
+
+// Failed checks so far
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+// Counts a failure that the caller has described on stderr already
+inline void Fail()
+{
+    ++TestFailures();
+}
+
+inline void Check(bool condition, char const* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << '\n';
+        Fail();
+    }
+}
+
+// EXIT_FAILURE after any failed check, otherwise reports that the test named name passed
+inline int TestResult(char const* name)
+{
+    if (TestFailures())
+        return EXIT_FAILURE;
+
+    std::cout << name << ": all checks passed\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
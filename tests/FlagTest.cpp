@@ -0,0 +1,95 @@
+// 8xy4 and 8xyE with x = F on every quirk profile and engine: VF ends up holding the flag
+// (0 or 1), not the result of the operation, and 8xyE's flag is the bit shifted out.
+
+#include "Check.hpp"
+#include "Chip8.hpp"
+#include "Lockstep.hpp"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    struct FlagCase
+    {
+        char const* name;
+        uint8_t rom[8];     // Three instructions, then a jump to itself
+        uint8_t vf;         // VF afterwards when the profile shifts Vx
+        uint8_t vfShiftVy;  // and when it shifts Vy (COSMAC VIP, XO-CHIP)
+    };
+
+    FlagCase const cases[] = {
+        // VF = 41, V1 = 80: the flag is bit 7 of VF (0) or of V1 (1), never the shifted value
+        {"8F1E", {0x6F, 0x41, 0x61, 0x80, 0x8F, 0x1E, 0x12, 0x06}, 0, 1},
+        // V2 = V1 = 80: bit 7 shifted out of either source is 1, not 0x80
+        {"821E", {0x62, 0x80, 0x61, 0x80, 0x82, 0x1E, 0x12, 0x06}, 1, 1},
+        // VF = F0, V1 = 20: the sum 110 carries, the flag replaces the 10 in VF
+        {"8F14 carry", {0x6F, 0xF0, 0x61, 0x20, 0x8F, 0x14, 0x12, 0x06}, 1, 1},
+        // VF = 10, V1 = 20: no carry, the flag replaces the 30 in VF
+        {"8F14 no carry", {0x6F, 0x10, 0x61, 0x20, 0x8F, 0x14, 0x12, 0x06}, 0, 0},
+    };
+
+    struct ProfileCase
+    {
+        QuirkProfile quirks;
+        bool shiftUsesVy;
+    };
+
+    ProfileCase const profiles[] = {
+        {QuirkProfile::Default, DefaultQuirks::shiftUsesVy},
+        {QuirkProfile::CosmacVip, CosmacVipQuirks::shiftUsesVy},
+        {QuirkProfile::Chip48, Chip48Quirks::shiftUsesVy},
+        {QuirkProfile::SuperChip, SuperChipQuirks::shiftUsesVy},
+        {QuirkProfile::XoChip, XoChipQuirks::shiftUsesVy},
+    };
+
+    void CheckFlag(char const* engine, QuirkProfile quirks, FlagCase const& test, uint8_t vf, uint8_t expected)
+    {
+        if (vf == expected)
+            return;
+
+        std::cerr << "FAILED: " << test.name << " on " << QuirkProfileName(quirks) << " (" << engine
+                  << "): VF = " << static_cast<unsigned int>(vf)
+                  << ", expected " << static_cast<unsigned int>(expected) << '\n';
+        Fail();
+    }
+}
+
+int main()
+{
+    Engine const engines[] = {Engine::Interpreter, Engine::Block, Engine::Switch};
+
+    for (ProfileCase const& profile : profiles)
+    {
+        for (FlagCase const& test : cases)
+        {
+            uint8_t expected = profile.shiftUsesVy ? test.vfShiftVy : test.vf;
+
+            for (Engine engine : engines)
+            {
+                std::unique_ptr<Chip8> chip8(new Chip8(profile.quirks));
+                chip8->LoadROM(test.rom, sizeof(test.rom));
+
+                for (unsigned int executed = 0; executed < 3;)
+                    executed += chip8->Step(engine, 3 - executed);
+
+                CheckFlag(EngineName(engine), profile.quirks, test, chip8->registers[0xF], expected);
+            }
+
+            // Lockstep batches mirror the default profile
+            if (profile.quirks == QuirkProfile::Default)
+            {
+                LockstepBatch batch(2);
+                batch.LoadROM(test.rom, sizeof(test.rom));
+                for (unsigned int i = 0; i < 3; ++i)
+                    batch.Step();
+
+                std::unique_ptr<Chip8> lane(new Chip8());
+                batch.CopyTo(0, *lane);
+                CheckFlag("lockstep", profile.quirks, test, lane->registers[0xF], expected);
+            }
+        }
+    }
+
+    return TestResult("Flags");
+}
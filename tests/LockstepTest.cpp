@@ -0,0 +1,72 @@
+// One lane of a LockstepBatch is forced off the common path by its input: the other lanes
+// must keep running together as a group, and every lane must end in the same state as a
+// Chip8 machine running the ROM on its own.
+
+#include "Check.hpp"
+#include "Chip8.hpp"
+#include "Differential.hpp"
+#include "Lockstep.hpp"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    const unsigned int LANES = 8;
+    const unsigned int DIVERGENT_LANE = 3;
+    const unsigned int STEPS = 1000;
+
+    // 200: LD V0, 1      V0 = 1
+    // 202: SKNP V0       only a lane holding key 1 runs the next instruction
+    // 204: ADD V1, 5     the divergent lane is one instruction behind from here on
+    // 206: RND V3, FF    the loop: every lane draws its own numbers
+    // 208: ADD V2, 1
+    // 20A: JP 206
+    uint8_t const rom[] = {0x60, 0x01, 0xE0, 0xA1, 0x71, 0x05, 0xC3, 0xFF, 0x72, 0x01, 0x12, 0x06};
+}
+
+int main()
+{
+    LockstepBatch batch(LANES);
+    Check(batch.LoadROM(rom, sizeof(rom)), "LoadROM");
+
+    for (unsigned int lane = 0; lane < LANES; ++lane)
+        batch.Seed(lane, lane);
+    batch.Key(DIVERGENT_LANE, 1) = 1;
+
+    for (unsigned int i = 0; i < STEPS; ++i)
+        batch.Step();
+
+    // LD and SKNP run converged, after the skip the divergent lane stays one instruction behind
+    Check(batch.convergedSteps == 2, "lanes converged until the skip");
+    Check(batch.divergedSteps == STEPS - 2, "lanes diverged after the skip");
+    Check(batch.singleLanes == batch.divergedSteps, "only the divergent lane ran alone");
+    Check(batch.groupedLanes == (LANES - 1) * batch.divergedSteps, "the other lanes ran as one group");
+
+    // Every lane matches a machine running on its own with the same seed and keys
+    std::unique_ptr<Chip8> lane(new Chip8());
+    for (unsigned int l = 0; l < LANES; ++l)
+    {
+        std::unique_ptr<Chip8> reference(new Chip8());
+        reference->LoadROM(rom, sizeof(rom));
+        SeedRandom(reference->randGen, l);
+        reference->keypad = l == DIVERGENT_LANE ? 1u << 1u : 0u;
+
+        for (unsigned int i = 0; i < STEPS; ++i)
+            reference->Cycle();
+
+        batch.CopyTo(l, *lane);
+        if (!SameState(*reference, *lane))
+        {
+            std::cerr << "Lane " << l << " differs from the reference:\n";
+            DescribeDifferences(*reference, *lane, std::cerr);
+            Fail();
+        }
+
+        // The random engine is compared too: one extra draw makes the machines differ
+        reference->randByte(reference->randGen);
+        Check(!SameState(*reference, *lane), "SameState sees an extra random draw");
+    }
+
+    return TestResult("Lockstep");
+}
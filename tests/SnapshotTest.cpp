@@ -0,0 +1,102 @@
+// Snapshots that do not fit the machine they are restored into are rejected before anything
+// changes: the machine stays exactly as it was.
+
+#include "Check.hpp"
+#include "Chip8.hpp"
+#include "Differential.hpp"
+#include "Snapshot.hpp"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    // 200: LD V0, 7; RND V1, FF; LD I, 300; LD [I], V1; CALL 20C; JP 20A; 20C: RET
+    uint8_t const rom[] = {0x60, 0x07, 0xC1, 0xFF, 0xA3, 0x00, 0xF1, 0x55, 0x22, 0x0C, 0x12, 0x0A, 0x00, 0xEE};
+
+    std::unique_ptr<Chip8> Machine(QuirkProfile quirks, unsigned int cycles)
+    {
+        std::unique_ptr<Chip8> chip8(new Chip8(quirks));
+        chip8->LoadROM(rom, sizeof(rom));
+        SeedRandom(chip8->randGen, 1);
+        for (unsigned int i = 0; i < cycles; ++i)
+            chip8->Cycle();
+        return chip8;
+    }
+
+    static uint8_t damaged[SNAPSHOT_SIZE];
+
+    // Restores damaged into a machine and checks that it refused and left the machine alone
+    void CheckDamagedRejected(QuirkProfile quirks, char const* what)
+    {
+        std::unique_ptr<Chip8> chip8 = Machine(quirks, 3);
+        std::unique_ptr<Chip8> before = Machine(quirks, 3);
+
+        Check(!RestoreSnapshot(*chip8, damaged, SNAPSHOT_SIZE), what);
+        if (!SameState(*chip8, *before))
+        {
+            std::cerr << "FAILED: " << what << " changed the machine:\n";
+            DescribeDifferences(*before, *chip8, std::cerr);
+            Fail();
+        }
+    }
+
+    // A copy of snapshot with one byte replaced must be rejected
+    void CheckRejected(uint8_t const* snapshot, size_t offset, uint8_t value, QuirkProfile quirks, char const* what)
+    {
+        memcpy(damaged, snapshot, SNAPSHOT_SIZE);
+        damaged[offset] = value;
+        CheckDamagedRejected(quirks, what);
+    }
+
+    // A copy of snapshot with I (offset 56, little-endian) replaced must be rejected
+    void CheckIndexRejected(uint8_t const* snapshot, uint16_t index, QuirkProfile quirks, char const* what)
+    {
+        memcpy(damaged, snapshot, SNAPSHOT_SIZE);
+        damaged[56] = index & 0xFFu;
+        damaged[57] = index >> 8u;
+        CheckDamagedRejected(quirks, what);
+    }
+}
+
+int main()
+{
+    static uint8_t snapshot[SNAPSHOT_SIZE];
+
+    for (QuirkProfile quirks : {QuirkProfile::Default, QuirkProfile::SuperChip, QuirkProfile::XoChip})
+    {
+        std::unique_ptr<Chip8> source = Machine(quirks, 10);
+        Check(SaveSnapshot(*source, snapshot, sizeof(snapshot)) == SNAPSHOT_SIZE, "SaveSnapshot");
+
+        // A valid snapshot round-trips
+        std::unique_ptr<Chip8> restored = Machine(quirks, 3);
+        Check(RestoreSnapshot(*restored, snapshot, sizeof(snapshot)), "restoring a valid snapshot");
+        Check(SameState(*source, *restored), "restored state matches the saved one");
+
+        CheckRejected(snapshot, 60, 17, quirks, "stack pointer past the stack");
+        CheckRejected(snapshot, 84, 0x4, quirks, "planes outside 0-3");
+        CheckRejected(snapshot, 63, 2, quirks, "unknown display mode");
+        CheckRejected(snapshot, 83, 0xFF, quirks, "random state past the modulus");
+        CheckIndexRejected(snapshot, 0xFFF8, quirks, "I far past memory");
+        CheckIndexRejected(snapshot, MEMORY_SIZE - 15, quirks, "I too close to the end of memory for Fx55");
+
+        // The highest I from which Fx55/Fx65 (16 bytes) stay in memory is accepted
+        memcpy(damaged, snapshot, SNAPSHOT_SIZE);
+        damaged[56] = (MEMORY_SIZE - 16) & 0xFFu;
+        damaged[57] = (MEMORY_SIZE - 16) >> 8u;
+        Check(RestoreSnapshot(*restored, damaged, SNAPSHOT_SIZE), "I at the top of memory");
+
+        if (quirks != QuirkProfile::XoChip)
+            CheckRejected(snapshot, 84, 0x3, quirks, "two planes without XO-CHIP");
+        if (quirks == QuirkProfile::Default)
+            CheckRejected(snapshot, 63, 1, quirks, "hi-res without SUPER-CHIP");
+    }
+
+    // A snapshot only restores into a machine with the profile it was taken with
+    std::unique_ptr<Chip8> schip = Machine(QuirkProfile::SuperChip, 10);
+    SaveSnapshot(*schip, snapshot, sizeof(snapshot));
+    CheckRejected(snapshot, 6, static_cast<uint8_t>(QuirkProfile::SuperChip), QuirkProfile::Default, "another quirk profile");
+
+    return TestResult("Snapshot");
+}